@@ -0,0 +1,340 @@
+// microbenchmarks for the parts the solver is built from, so a slowdown can be pinned on one of them
+// usage: ShakFinderBench [--filter=<text>] [--time=<ms>] [--save=<file>] [--baseline=<file>] [--threshold=<percent>]
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Solver/Fumen.hpp"
+#include "Solver/Parser.hpp"
+#include "Solver/Util.hpp"
+
+// results are folded into this so the compiler can't drop the work being timed
+static volatile uint64_t sink = 0;
+
+struct Benchmark {
+    std::string name;
+    // does a batch of the operation and returns how many operations that was
+    std::function<size_t()> batch;
+};
+
+struct Measurement {
+    // the median of the samples
+    double ns_per_op = 0;
+    // the standard deviation of the samples
+    double stddev = 0;
+};
+
+// times a benchmark in samples of whole batches, repeating batches until a sample is long enough for the clock
+static Measurement measure(const Benchmark& benchmark, double seconds) {
+    using clock = std::chrono::steady_clock;
+    constexpr int SAMPLES = 15;
+    const double sample_ns = seconds * 1e9 / SAMPLES;
+
+    // warm up the caches and find how many batches make a sample
+    size_t repeats = 1;
+    for (;;) {
+        const auto begin = clock::now();
+        for (size_t i = 0; i < repeats; ++i)
+            benchmark.batch();
+        const double elapsed = std::chrono::duration<double, std::nano>(clock::now() - begin).count();
+        if (elapsed >= sample_ns || repeats >= (size_t(1) << 30))
+            break;
+        // aim a little past the target so this rarely takes more than one more round
+        repeats = elapsed <= 0 ? repeats * 16 : std::max(repeats + 1, size_t(repeats * sample_ns * 1.2 / elapsed));
+    }
+
+    std::vector<double> samples;
+    for (int sample = 0; sample < SAMPLES; ++sample) {
+        size_t ops = 0;
+        const auto begin = clock::now();
+        for (size_t i = 0; i < repeats; ++i)
+            ops += benchmark.batch();
+        const double elapsed = std::chrono::duration<double, std::nano>(clock::now() - begin).count();
+        samples.push_back(elapsed / std::max<size_t>(ops, 1));
+    }
+
+    double mean = 0;
+    for (double sample : samples)
+        mean += sample;
+    mean /= samples.size();
+    double variance = 0;
+    for (double sample : samples)
+        variance += (sample - mean) * (sample - mean);
+    variance /= samples.size() - 1;
+
+    std::sort(samples.begin(), samples.end());
+    return {.ns_per_op = samples[samples.size() / 2], .stddev = std::sqrt(variance)};
+}
+
+// fields of at most 4 lines like the ones pcs are searched on, stacks of random column heights with no full rows
+static std::vector<Board> make_corpus(size_t count) {
+    // every kernel here reads the board words directly, a different layout would make the timings meaningless
+    if (!board_layout_matches()) {
+        std::cerr << "the board layout doesn't match the one Util.hpp assumes" << std::endl;
+        std::exit(1);
+    }
+
+    // mt19937 gives the same numbers everywhere, the distributions don't, so it is used raw
+    std::mt19937 random(0x5eed);
+    std::vector<Board> corpus;
+    while (corpus.size() < count) {
+        std::array<int, Board::width> heights{};
+        for (int& height : heights)
+            height = random() % 5;
+        // a full row would just be cleared, so one column is cut down under it
+        for (int row = 0; row < 4; ++row) {
+            if (std::all_of(heights.begin(), heights.end(), [&](int height) { return height > row; }))
+                heights[random() % Board::width] = row;
+        }
+
+        Board board;
+        for (int x = 0; x < (int)Board::width; ++x)
+            for (int y = 0; y < heights[x]; ++y)
+                board.set(x, y);
+        const bool seen = std::any_of(corpus.begin(), corpus.end(), [&](const Board& other) { return board_rows(other) == board_rows(board); });
+        if (!seen)
+            corpus.push_back(board);
+    }
+    return corpus;
+}
+
+// writes the fields as a fumen with a page for each, only what Fumen::parse reads of a page is written
+static std::string encode_fumen(const std::vector<Board>& boards) {
+    std::string text = "v115@";
+    auto put = [&](int number, int digits) {
+        for (int i = 0; i < digits; ++i, number /= 64)
+            text.push_back(Fumen::BASE64_CHARS[number % 64]);
+    };
+
+    std::array<int, 240> previous{};
+    for (const Board& board : boards) {
+        // fumen goes from the top row down, with the garbage row last
+        std::array<int, 240> cells{};
+        for (int y = 0; y < 23; ++y)
+            for (int x = 0; x < (int)Board::width; ++x)
+                cells[y * 10 + x] = cell_filled(board, x, 22 - y) ? Fumen::Gray : Fumen::Empty;
+
+        // the field is stored as runs of the change from the last page
+        for (size_t i = 0; i < cells.size();) {
+            const int delta = cells[i] - previous[i] + 8;
+            size_t run = 1;
+            while (i + run < cells.size() && cells[i + run] - previous[i + run] + 8 == delta)
+                ++run;
+            put(delta * 240 + int(run) - 1, 2);
+            i += run;
+        }
+        // no piece and no flags
+        put(0, 3);
+        previous = cells;
+    }
+    return text;
+}
+
+// the benchmarks file a --save writes and a --baseline reads, one "name ns_per_op stddev" line each
+static std::map<std::string, Measurement> read_baseline(const std::string& path) {
+    std::map<std::string, Measurement> baseline;
+    std::ifstream file(path);
+    for (std::string line; std::getline(file, line);) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        std::string name;
+        Measurement measurement;
+        if (fields >> name >> measurement.ns_per_op >> measurement.stddev)
+            baseline[name] = measurement;
+    }
+    return baseline;
+}
+
+static std::vector<Benchmark> make_benchmarks() {
+    std::vector<Benchmark> benchmarks;
+    const auto corpus = std::make_shared<std::vector<Board>>(make_corpus(64));
+    constexpr std::array<PieceType, 7> PIECES = {PieceType::I, PieceType::J, PieceType::L, PieceType::O, PieceType::S, PieceType::T, PieceType::Z};
+
+    // the raw movegen from the normal spawn, without the line limit the solver puts on it
+    for (PieceType piece : PIECES) {
+        benchmarks.push_back({"binary_bfs/" + std::string(1, (char)piece), [corpus, piece] {
+            uint64_t checksum = 0;
+            for (const Board& board : *corpus) {
+                auto moves = reachability::search::binary_bfs<reachability::blocks::SRS, reachability::coord{4, 20}>(board, piece);
+                for (std::size_t rot = 0; rot < moves.size(); ++rot)
+                    checksum += moves[rot].data[0];
+            }
+            sink = sink + checksum;
+            return corpus->size();
+        }});
+    }
+
+    // every placement of every piece on the corpus under 4 lines, placed the way the search does it
+    struct Placement {
+        Game game;
+        FullPiece piece;
+    };
+    auto placements = std::make_shared<std::vector<Placement>>();
+    for (const Board& board : *corpus) {
+        for (PieceType piece : PIECES) {
+            Game game;
+            game.board = board;
+            game.current_piece = piece;
+            game.queue.fill(PieceType::Empty);
+            const auto moves = Game::piece_movegen<Rules::Srs>(board, piece, 4);
+            for (std::size_t rot = 0; rot < moves.size(); ++rot) {
+                for_each_set_cell(moves[rot], Board::height, [&](int x, int y) {
+                    placements->push_back({game, {.type = piece, .x = (int8_t)x, .y = (int8_t)y, .r = (int8_t)rot}});
+                    return false;
+                });
+            }
+        }
+    }
+    benchmarks.push_back({"place_piece+clear_full_lines", [placements] {
+        uint64_t checksum = 0;
+        for (const Placement& placement : *placements) {
+            Game game = placement.game;
+            game.place_piece(placement.piece);
+            checksum += game.board.clear_full_lines() + game.board.data[0];
+        }
+        sink = sink + checksum;
+        return placements->size();
+    }});
+
+    // patterns as big as the ones people run, preprocessed up front like the cli does
+    for (std::string pattern : {"*p7", "[SZLJ]p2,*!", "T,*p4,*p3"}) {
+        const std::string preprocessed = Parser::preprocess(pattern);
+        benchmarks.push_back({"parse/" + pattern, [preprocessed] {
+            sink = sink + Parser::parse(preprocessed).size();
+            return size_t(1);
+        }});
+    }
+
+    for (int count : {4, 7}) {
+        benchmarks.push_back({"get_combinations/7p" + std::to_string(count), [count] {
+            sink = sink + Parser::get_combinations({PieceType::T, PieceType::I, PieceType::L, PieceType::J, PieceType::S, PieceType::Z, PieceType::O}, count).size();
+            return size_t(1);
+        }});
+    }
+
+    // a single field and a long fumen with a page for every field of the corpus
+    for (size_t pages : {size_t(1), corpus->size()}) {
+        const std::string text = encode_fumen(std::vector<Board>(corpus->begin(), corpus->begin() + pages));
+        // the encoder is only here for the benchmark, so make sure it says what it should
+        auto decoded = Fumen::parse(text);
+        if (!decoded.has_value() || board_rows(Fumen::to_board(decoded->pages[0].field)) != board_rows(corpus->front())) {
+            std::cerr << "the fumen written for the benchmark does not read back" << std::endl;
+            std::exit(1);
+        }
+        benchmarks.push_back({"fumen_parse/" + std::to_string(pages) + (pages == 1 ? "page" : "pages"), [text] {
+            auto fumen = Fumen::parse(text);
+            sink = sink + (fumen.has_value() ? fumen->pages.size() : 0);
+            return size_t(1);
+        }});
+    }
+
+    return benchmarks;
+}
+
+int main(int argc, char** argv) {
+    std::string filter;
+    double seconds = 0.5;
+    std::string save_path;
+    std::string baseline_path;
+    double threshold = 5;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        auto value = [&](std::string_view name) -> std::optional<std::string_view> {
+            if (arg.starts_with(name) && arg.size() > name.size() && arg[name.size()] == '=')
+                return arg.substr(name.size() + 1);
+            return std::nullopt;
+        };
+        auto number = [](std::string_view text) -> std::optional<double> {
+            double result = 0;
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), result);
+            if (error != std::errc() || end != text.data() + text.size() || result <= 0)
+                return std::nullopt;
+            return result;
+        };
+
+        if (auto text = value("--filter"); text.has_value())
+            filter = *text;
+        else if (auto text = value("--save"); text.has_value())
+            save_path = *text;
+        else if (auto text = value("--baseline"); text.has_value())
+            baseline_path = *text;
+        else if (auto text = value("--time"); text.has_value() && number(*text).has_value())
+            seconds = *number(*text) / 1000;
+        else if (auto text = value("--threshold"); text.has_value() && number(*text).has_value())
+            threshold = *number(*text);
+        else {
+            std::cout << "usage: " << argv[0]
+                << " [--filter=<text>] [--time=<ms per benchmark>] [--save=<file>] [--baseline=<file>] [--threshold=<percent>]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::map<std::string, Measurement> baseline;
+    if (!baseline_path.empty()) {
+        baseline = read_baseline(baseline_path);
+        if (baseline.empty()) {
+            std::cout << "could not read a baseline from " << baseline_path << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream saved;
+    if (!save_path.empty()) {
+        saved.open(save_path);
+        if (!saved) {
+            std::cout << "could not write " << save_path << std::endl;
+            return 1;
+        }
+        saved << "# name ns_per_op stddev" << std::endl;
+        saved << std::setprecision(10);
+    }
+
+    int regressions = 0;
+    std::cout << std::fixed << std::setprecision(1);
+    for (const Benchmark& benchmark : make_benchmarks()) {
+        if (benchmark.name.find(filter) == std::string::npos)
+            continue;
+
+        const Measurement measurement = measure(benchmark, seconds);
+        std::cout << std::left << std::setw(30) << benchmark.name << std::right << std::setw(14) << measurement.ns_per_op
+            << " ns/op  +-" << std::setw(5) << measurement.stddev * 100 / measurement.ns_per_op << "%";
+        if (saved.is_open())
+            saved << benchmark.name << ' ' << measurement.ns_per_op << ' ' << measurement.stddev << std::endl;
+
+        if (auto old = baseline.find(benchmark.name); old != baseline.end()) {
+            const double change = (measurement.ns_per_op - old->second.ns_per_op) * 100 / old->second.ns_per_op;
+            // a change inside the noise of both runs says nothing either way
+            const double noise = 2 * std::hypot(measurement.stddev, old->second.stddev);
+            const bool significant = std::abs(measurement.ns_per_op - old->second.ns_per_op) > noise && std::abs(change) > threshold;
+            std::cout << "  was " << std::setw(12) << old->second.ns_per_op << std::showpos << std::setw(8) << change
+                << std::noshowpos << "%" << (significant ? change > 0 ? "  slower" : "  faster" : "");
+            if (significant && change > 0)
+                regressions++;
+        }
+        std::cout << std::endl;
+    }
+
+    if (!baseline.empty() && regressions > 0) {
+        std::cout << regressions << " benchmarks got slower than the baseline" << std::endl;
+        return 2;
+    }
+    return 0;
+}
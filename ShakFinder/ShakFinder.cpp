@@ -1,16 +1,209 @@
 ﻿#include "ShakFinder.h"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
 #include <chrono>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <string_view>
 
+#include "Solver/Chain.hpp"
+#include "Solver/Checkpoint.hpp"
 #include "Solver/Parser.hpp"
+#include "Solver/Progress.hpp"
 #include "Solver/Solver.hpp"
 #include "Solver/Fumen.hpp"
+#include "Solver/Nogood.hpp"
+#include "Solver/Output.hpp"
+#include "Solver/QueueFile.hpp"
+#include "Solver/ResultCache.hpp"
+#include "Solver/SolutionPool.hpp"
+#include "Solver/ThreadPool.hpp"
+#include "Solver/Tiling.hpp"
+
+// returns the value of a --name=value flag
+static std::optional<std::string_view> flag_value(const std::vector<std::string_view>& flags, std::string_view name) {
+    for (std::string_view flag : flags) {
+        if (flag.starts_with(name) && flag.size() > name.size() && flag[name.size()] == '=')
+            return flag.substr(name.size() + 1);
+    }
+    return std::nullopt;
+}
+
+// returns whether a bare --name flag was given
+static bool has_flag(const std::vector<std::string_view>& flags, std::string_view name) {
+    return std::find(flags.begin(), flags.end(), name) != flags.end();
+}
+
+// returns the value of a --name=number flag, nullopt if it is missing or not a number
+static std::optional<long long> flag_number(const std::vector<std::string_view>& flags, std::string_view name) {
+    auto value = flag_value(flags, name);
+    if (!value.has_value())
+        return std::nullopt;
+    long long number = 0;
+    auto [end, error] = std::from_chars(value->data(), value->data() + value->size(), number);
+    if (error != std::errc() || end != value->data() + value->size())
+        return std::nullopt;
+    return number;
+}
+
+struct Field {
+    std::string fumen;
+    size_t page = 0;
+    Board board;
+};
+
+// source is either a fumen or a file with one fumen per line
+// batch mode searches every page of every fumen, the other modes only the first page
+static std::vector<Field> read_fields(const std::string& source, bool all_pages) {
+    std::vector<std::string> fumens;
+    if (source.starts_with("v115@")) {
+        fumens.push_back(source);
+    }
+    else {
+        std::ifstream file(source);
+        for (std::string line; std::getline(file, line);) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!line.empty())
+                fumens.push_back(line);
+        }
+    }
+
+    std::vector<Field> fields;
+    for (const std::string& text : fumens) {
+        auto fumen = Fumen::parse(text);
+        if (!fumen.has_value() || fumen->pages.empty())
+            return {};
+        const size_t pages = all_pages ? fumen->pages.size() : 1;
+        for (size_t page = 0; page < pages; ++page)
+            fields.push_back({.fumen = text, .page = page, .board = Fumen::to_board(fumen->pages[page].field)});
+        if (!all_pages)
+            break;
+    }
+    return fields;
+}
+
+static void print_usage(const char* name) {
+    std::cout << "Usage: ./" << name << " <fumen> <paths|percents|count|chain|score|earliest> <queue>"
+        << " [--format=text|csv|jsonl|fails] [--scoring=tetrio|jstris] [--timeout=<ms per queue>] [--cache=<file>] [--bags]"
+        << " [--rules=srs|srs180|srs-nohold|srs180-nohold] [--engine=search|tiling] [--pool=<solutions>] [--shard=<i>/<n>]"
+        << " [--checkpoint=<file> [--resume]] [--progress[=<stats file>]] [--dead-cache-mb=<size>] [--order=natural|lowest|holes|flat] [--stages=<pcs in a chain>]" << std::endl;
+    std::cout << "       ./" << name << " <fumen|file of fumens> batch <queue> [--threads=<count>] [--progress[=<stats file>]]" << std::endl;
+    std::cout << "       ./" << name << " <fumen|file of fumens> compare <queue> [--threads=<count>] [--bags]" << std::endl;
+    std::cout << "       percents and batch also take @<queue file> as the queue, a file of queues one per line or packed by pack" << std::endl;
+    std::cout << "       ./" << name << " compact <cache file>" << std::endl;
+    std::cout << "       ./" << name << " pack <queue file> <packed queue file>" << std::endl;
+    std::cout << "       ./" << name << " merge <csv or jsonl results>... [--format=text|csv|jsonl|fails]" << std::endl;
+}
 
 int main(int argc,const char* argv[]) {
     std::span<const char*> args(argv, argc);
+    if (!board_layout_matches()) {
+        std::cerr << "the reachability board layout doesn't match the one Solver/Util.hpp assumes, pin the dependency to a matching commit" << std::endl;
+        return 1;
+    }
 	
-    std::vector vargs = std::vector(args.begin(), args.end());
+    // anything starting with -- is a flag, everything else is positional
+    std::vector<const char*> vargs;
+    std::vector<std::string_view> flags;
+    for (const char* arg : args) {
+        if (std::string_view(arg).starts_with("--"))
+            flags.emplace_back(arg);
+        else
+            vargs.push_back(arg);
+    }
+
+    if (vargs.size() == 3 && strcmp(vargs[1], "compact") == 0) {
+        if (!ResultCache::compact(vargs[2])) {
+            std::cout << "could not compact " << vargs[2] << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // a text queue file as 3 bits per piece, a third of the size and read without parsing
+    if (vargs.size() == 4 && strcmp(vargs[1], "pack") == 0) {
+        std::string error;
+        if (!QueueFile::pack(vargs[2], vargs[3], error)) {
+            std::cout << error << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // the runs of every shard of a --shard run, written with --format=csv or jsonl, back into one
+    if (vargs.size() >= 3 && strcmp(vargs[1], "merge") == 0) {
+        auto format = Output::parse_format(flag_value(flags, "--format").value_or("text"));
+        if (!format.has_value()) {
+            std::cout << "unknown output format, expected text, csv, jsonl or fails" << std::endl;
+            return 1;
+        }
+
+        std::vector<Output::QueueResult> results;
+        // every shard says how many queues the pattern has, so queues missing at the end are noticed as well
+        std::optional<size_t> pattern_total;
+        for (size_t i = 2; i < vargs.size(); i++) {
+            std::ifstream file(vargs[i]);
+            std::optional<size_t> shard_total;
+            auto shard = file ? Output::read_results(file, shard_total) : std::nullopt;
+            if (!shard.has_value()) {
+                std::cout << "could not read results from " << vargs[i] << std::endl;
+                return 1;
+            }
+            if (!shard_total.has_value()) {
+                std::cout << vargs[i] << " has no pattern size, it is not a finished --shard run" << std::endl;
+                return 1;
+            }
+            if (pattern_total.has_value() && *pattern_total != *shard_total) {
+                std::cout << vargs[i] << " is a shard of a pattern of " << *shard_total << " queues, not " << *pattern_total << std::endl;
+                return 1;
+            }
+            pattern_total = shard_total;
+            results.insert(results.end(), std::make_move_iterator(shard->begin()), std::make_move_iterator(shard->end()));
+        }
+        std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) { return a.index < b.index; });
+        for (size_t i = 1; i < results.size(); i++) {
+            if (results[i].index == results[i - 1].index) {
+                std::cout << "queue " << results[i].index << " is in more than one shard" << std::endl;
+                return 1;
+            }
+        }
+        if (!results.empty() && results.back().index >= *pattern_total) {
+            std::cout << "queue " << results.back().index << " is past the end of the pattern" << std::endl;
+            return 1;
+        }
+        // no duplicates and nothing past the end, so whatever is short of the pattern is missing
+        // a percentage over part of the pattern looks just like a real one, so this is an error in every format
+        if (results.size() != *pattern_total) {
+            std::cerr << "missing " << *pattern_total - results.size() << " of " << *pattern_total << " queues, not every shard was given" << std::endl;
+            return 1;
+        }
+
+        Output::Writer writer(std::cout, *format);
+        Output::Summary summary{.total = *pattern_total};
+        const bool weighted = !results.empty() && results[0].probability.has_value();
+        double weighted_solved = 0;
+        for (size_t i = 0; i < results.size(); i++) {
+            if (results[i].solved) {
+                summary.solved++;
+                weighted_solved += results[i].probability.value_or(0);
+            }
+            if (results[i].timed_out)
+                summary.timed_out++;
+            writer.result(std::move(results[i]));
+        }
+        if (weighted)
+            summary.weighted_percentage = weighted_solved * 100.0;
+        writer.summary(summary);
+        return 0;
+    }
 
     if(vargs.size() < 4)
         vargs = {
@@ -22,93 +215,751 @@ int main(int argc,const char* argv[]) {
         };
 
     if (vargs.size() < 4) {
-        std::cout << "Usage: ./" << args[0] << " <fumen> <paths|percents> <queue>" << std::endl;
+        print_usage(args[0]);
+        return 1;
+    }
+
+    auto format = Output::parse_format(flag_value(flags, "--format").value_or("text"));
+    if (!format.has_value()) {
+        std::cout << "unknown output format, expected text, csv, jsonl or fails" << std::endl;
         return 1;
     }
 
-    auto fumen = Fumen::parse(vargs[1]);
-    if (!fumen.has_value())
+    std::optional<Solver::Scorer> scorer;
+    std::string_view scoring = flag_value(flags, "--scoring").value_or("tetrio");
+    if (scoring == "tetrio")
+        scorer = tetrio_points{};
+    else if (scoring == "jstris")
+        scorer = JstrisScore{};
+    else {
+        std::cout << "unknown scoring, expected tetrio or jstris" << std::endl;
+        return 1;
+    }
+
+    // every queue gets its own deadline, counted from when its search starts
+    std::optional<std::chrono::milliseconds> timeout;
+    if (flag_value(flags, "--timeout").has_value()) {
+        auto ms = flag_number(flags, "--timeout");
+        if (!ms.has_value() || *ms <= 0) {
+            std::cout << "--timeout expects a positive number of milliseconds" << std::endl;
+            return 1;
+        }
+        timeout = std::chrono::milliseconds(*ms);
+    }
+    auto limits = [&timeout]() {
+        Solver::SearchLimits limits;
+        if (timeout.has_value())
+            limits.deadline = std::chrono::steady_clock::now() + *timeout;
+        return limits;
+    };
+
+    std::optional<ResultCache> cache;
+    if (auto cache_path = flag_value(flags, "--cache"); cache_path.has_value()) {
+        cache.emplace(std::string(*cache_path));
+        if (!cache->is_open()) {
+            std::cout << "could not open cache " << *cache_path << std::endl;
+            return 1;
+        }
+    }
+    // the search is compiled once per ruleset, this only picks which one runs
+    auto rules = Rules::parse(flag_value(flags, "--rules").value_or("srs"));
+    if (!rules.has_value()) {
+        std::cout << "unknown rules, expected srs, srs180, srs-nohold or srs180-nohold" << std::endl;
+        return 1;
+    }
+    const uint8_t CACHE_RULES = uint8_t(*rules);
+
+    // tiling works out every way to fill the field up front, which pays off over patterns with many queues
+    auto engine = flag_value(flags, "--engine").value_or("search");
+    if (engine != "search" && engine != "tiling") {
+        std::cout << "unknown engine, expected search or tiling" << std::endl;
+        return 1;
+    }
+
+    size_t threads = 0;
+    if (flag_value(flags, "--threads").has_value()) {
+        auto count = flag_number(flags, "--threads");
+        if (!count.has_value() || *count < 0) {
+            std::cout << "--threads expects a number, 0 for one per core" << std::endl;
+            return 1;
+        }
+        threads = *count;
+    }
+
+    // how many recent pcs percents tries on a queue before searching it, 0 turns it off
+    size_t pool_size = 64;
+    if (flag_value(flags, "--pool").has_value()) {
+        auto size = flag_number(flags, "--pool");
+        if (!size.has_value() || *size < 0) {
+            std::cout << "--pool expects a number, 0 to turn it off" << std::endl;
+            return 1;
+        }
+        pool_size = *size;
+    }
+
+    // --shard=i/n runs every nth queue starting from the ith, so shards of a pattern share out the slow queues
+    size_t shard_first = 0;
+    size_t shard_step = 1;
+    if (auto shard = flag_value(flags, "--shard"); shard.has_value()) {
+        const size_t slash = shard->find('/');
+        size_t index = 0, count = 0;
+        bool valid = slash != std::string_view::npos;
+        if (valid) {
+            auto [index_end, index_error] = std::from_chars(shard->data(), shard->data() + slash, index);
+            auto [count_end, count_error] = std::from_chars(shard->data() + slash + 1, shard->data() + shard->size(), count);
+            valid = index_error == std::errc() && index_end == shard->data() + slash
+                && count_error == std::errc() && count_end == shard->data() + shard->size();
+        }
+        if (!valid || count == 0 || index == 0 || index > count) {
+            std::cout << "--shard expects <i>/<n> with i from 1 to n" << std::endl;
+            return 1;
+        }
+        if (strcmp(vargs[2], "batch") == 0 || strcmp(vargs[2], "compare") == 0) {
+            std::cout << vargs[2] << " sums up whole fields, so it can't be sharded by queue" << std::endl;
+            return 1;
+        }
+        shard_first = index - 1;
+        shard_step = count;
+    }
+
+    // states proven to have no pc in any order, shared by every queue of percents and batch, 0 turns it off
+    size_t dead_cache_mb = Solver::NogoodCache::DEFAULT_BYTES >> 20;
+    if (flag_value(flags, "--dead-cache-mb").has_value()) {
+        auto size = flag_number(flags, "--dead-cache-mb");
+        if (!size.has_value() || *size < 0) {
+            std::cout << "--dead-cache-mb expects a number, 0 to turn it off" << std::endl;
+            return 1;
+        }
+        dead_cache_mb = *size;
+    }
+    std::optional<Solver::NogoodCache> dead_cache;
+    if (dead_cache_mb != 0)
+        dead_cache.emplace(dead_cache_mb << 20);
+
+    // which placements a search tries first, it only changes how fast a pc is found and never the answer
+    std::optional<Solver::MoveOrder> order = Solver::MoveOrder::Natural;
+    std::string_view order_name = "natural";
+    if (auto name = flag_value(flags, "--order"); name.has_value()) {
+        order = Solver::parse_move_order(*name);
+        if (!order.has_value()) {
+            std::cout << "--order expects natural, lowest, holes or flat" << std::endl;
+            return 1;
+        }
+        order_name = *name;
+    }
+
+    const Solver::SearchOptions options{.nogoods = dead_cache.has_value() ? &*dead_cache : nullptr, .order = *order};
+    auto search_pc = [&](const Board& field, const Queue& queue) {
+        return Solver::can_pc(field, queue, limits(), *rules, options);
+    };
+
+    auto fields = read_fields(vargs[1], strcmp(vargs[2], "batch") == 0 || strcmp(vargs[2], "compare") == 0);
+    if (fields.empty())
     {
         std::cout << "could not parse fumen" << std::endl;
         return 1;
     }
-    //fumen.value().pages[0].print_field();
 
-    auto board = Fumen::to_board(fumen.value().pages[0].field);
+    auto board = fields[0].board;
 
     auto begin = std::chrono::steady_clock::now();
 
-    auto queues = Parser::parse(Parser::preprocess(vargs[3]));
-    std::cout << "generated queues!" << std::endl;
-    
-    if (strcmp(vargs[2], "percents") == 0) {
-		size_t total_solved = 0;
-        for (int i = 0; i < queues.size(); i++) {
-			bool solved = Solver::can_pc(board, queues[i]);
-        
-			if (!solved) {
-				std::cout << "unsolvable: ";
-				for (const PieceType& piece : queues[i]) {
-					std::cout << Parser::getChar(piece);
-				}
-				std::cout << std::endl;
-			}
-			else {
-                total_solved++;
-				std::cout << "solved: ";
-				for (const PieceType& piece : queues[i]) {
-					std::cout << Parser::getChar(piece);
-				}
+    // with --bags the pattern is read as draws from a 7 bag and every queue comes with its chance of being dealt
+    std::vector<Queue> queues;
+    std::optional<std::vector<double>> chances;
+    // @<file> leaves queues empty, the queues are read from the file a chunk at a time while they are solved
+    std::optional<QueueFile> queue_file;
+    if (vargs[3][0] == '@') {
+        queue_file.emplace(vargs[3] + 1);
+        if (!queue_file->is_open()) {
+            std::cout << queue_file->error() << std::endl;
+            return 1;
+        }
+        if (strcmp(vargs[2], "percents") != 0 && strcmp(vargs[2], "batch") != 0) {
+            std::cout << "only percents and batch can read a queue file" << std::endl;
+            return 1;
+        }
+        // these need every queue up front or one queue after another
+        for (std::string_view flag : {"--bags", "--checkpoint", "--shard"}) {
+            if (has_flag(flags, flag) || flag_value(flags, flag).has_value()) {
+                std::cout << flag << " doesn't work with a queue file" << std::endl;
+                return 1;
+            }
+        }
+        if (engine == "tiling") {
+            std::cout << "the tiling engine doesn't work with a queue file" << std::endl;
+            return 1;
+        }
+    }
+    else if (has_flag(flags, "--bags")) {
+        chances.emplace();
+        for (auto& weighted : Parser::parse_bags(vargs[3])) {
+            queues.push_back(std::move(weighted.queue));
+            chances->push_back(weighted.probability);
+        }
+    }
+    else {
+        queues = Parser::parse(Parser::preprocess(vargs[3]));
+    }
+    auto chance = [&chances](size_t i) -> std::optional<double> {
+        if (!chances.has_value())
+            return std::nullopt;
+        return (*chances)[i];
+    };
 
-				std::cout << std::endl;
-			}
+    // --checkpoint=<file> saves how far percents got every so often, --resume carries on from there
+    std::optional<Checkpoint> checkpoint;
+    if (auto checkpoint_path = flag_value(flags, "--checkpoint"); checkpoint_path.has_value()) {
+        if (strcmp(vargs[2], "percents") != 0) {
+            std::cout << "only percents can be checkpointed" << std::endl;
+            return 1;
         }
+        // everything that changes which queues are run or what comes out of them
+        std::string run = std::string(vargs[1]) + "\n" + vargs[3] + "\n" + std::to_string(queues.size());
+        for (std::string_view flag : {"--rules", "--shard", "--timeout"})
+            run += "\n" + std::string(flag_value(flags, flag).value_or(""));
+        run += has_flag(flags, "--bags") ? "\nbags" : "";
+        // these only change which queues time out, they are left out when not given so older checkpoints still resume
+        for (std::string_view flag : {"--order", "--engine", "--dead-cache-mb", "--pool"})
+            if (auto value = flag_value(flags, flag); value.has_value())
+                run += "\n" + std::string(flag) + "=" + std::string(*value);
+
+        checkpoint.emplace(std::string(*checkpoint_path), Checkpoint::fingerprint(run));
+        if (has_flag(flags, "--resume")) {
+            std::string error;
+            if (!checkpoint->load(error) && !error.empty()) {
+                std::cout << error << std::endl;
+                return 1;
+            }
+        }
+    }
+    else if (has_flag(flags, "--resume")) {
+        std::cout << "--resume needs the --checkpoint=<file> to resume from" << std::endl;
+        return 1;
+    }
+
+    Output::Writer writer(std::cout, format.value(), {.score = strcmp(vargs[2], "score") == 0, .lines = strcmp(vargs[2], "earliest") == 0});
+    writer.note("generated queues!");
     
-		std::cout << "solved/total: " << total_solved  << "/" << queues.size() << std::endl;
-		std::cout << "percentage: " << ((float)total_solved / queues.size()) * 100.0f << "%" << std::endl;
+    size_t total_solved = 0;
+    size_t total_timed_out = 0;
+    size_t total = queues.size() > shard_first ? (queues.size() - shard_first + shard_step - 1) / shard_step : 0;
+    // the chance of a pc over every queue, only with --bags
+    double weighted_solved = 0;
+
+    // --progress reports how the run is going on stderr every second, --progress=<file> keeps the latest report in a file
+    std::optional<Progress> progress;
+    auto track = [&](size_t count) {
+        if (has_flag(flags, "--progress"))
+            progress.emplace(count, std::nullopt);
+        else if (auto stats_path = flag_value(flags, "--progress"); stats_path.has_value())
+            progress.emplace(count, std::string(*stats_path));
+    };
+    // searches a queue on a field from any thread, going through the result cache
+    std::mutex cache_mutex;
+    auto solve = [&](const Board& field, const Queue& queue) {
+        if (cache.has_value()) {
+            std::lock_guard lock(cache_mutex);
+            if (auto entry = cache->find(field, queue, Solver::PC_HEIGHT, CACHE_RULES); entry.has_value())
+                return Solver::SearchResult{.status = entry->solvable ? Solver::Status::Solved : Solver::Status::Unsolvable};
+        }
+        auto search = search_pc(field, queue);
+        if (cache.has_value() && search.status != Solver::Status::TimedOut) {
+            std::lock_guard lock(cache_mutex);
+            cache->insert(field, queue, Solver::PC_HEIGHT, CACHE_RULES, {.solvable = search.status == Solver::Status::Solved, .witness = std::move(search.witness)});
+        }
+        return search;
+    };
+
+    if (queue_file.has_value()) {
+        // a window of chunks is numbered, solved by the workers and written out before the next,
+        // so the output is in file order and only the results of one window are ever kept
+        const bool batch = strcmp(vargs[2], "batch") == 0;
+        const size_t jobs_per_chunk = batch ? fields.size() : 1;
+        ThreadPool workers(threads);
+        const size_t window = workers.size() * 4;
+
+        std::vector<std::atomic<size_t>> field_solved(fields.size());
+        std::vector<std::atomic<size_t>> field_timed_out(fields.size());
+
+        // counting the queues of a text file reads all of it, so it is only done for the progress report
+        const bool tracking = has_flag(flags, "--progress") || flag_value(flags, "--progress").has_value();
+        track(tracking ? queue_file->count() * jobs_per_chunk : 0);
+
+        size_t queue_count = 0;
+        std::string error;
+        for (size_t chunk = 0; chunk < queue_file->chunks() && error.empty(); chunk += window) {
+            const size_t chunks = std::min(window, queue_file->chunks() - chunk);
+            std::vector<size_t> first(chunks);
+            for (size_t k = 0; k < chunks; ++k) {
+                first[k] = queue_count;
+                queue_count += queue_file->count(chunk + k);
+            }
+
+            std::vector<std::vector<Output::QueueResult>> results(batch ? 0 : chunks);
+            std::vector<std::string> errors(chunks * jobs_per_chunk);
+            workers.for_each_index(chunks * jobs_per_chunk, [&](size_t job) {
+                const size_t k = job / jobs_per_chunk;
+                const size_t field = job % jobs_per_chunk;
+                size_t index = first[k];
+                queue_file->for_each_queue(chunk + k, [&](const Queue& queue) {
+                    if (progress.has_value())
+                        progress->start(index);
+                    auto search = solve(fields[field].board, queue);
+                    const bool solved = search.status == Solver::Status::Solved;
+                    const bool timed_out = search.status == Solver::Status::TimedOut;
+                    if (progress.has_value())
+                        progress->finish(solved, search.stats.nodes);
+
+                    if (batch) {
+                        if (solved)
+                            field_solved[field]++;
+                        if (timed_out)
+                            field_timed_out[field]++;
+                    }
+                    else {
+                        results[k].push_back({.index = index, .queue = queue, .solved = solved, .timed_out = timed_out});
+                    }
+                    index++;
+                }, errors[job]);
+            });
+
+            for (const std::string& message : errors) {
+                if (!message.empty()) {
+                    error = message;
+                    break;
+                }
+            }
+            for (auto& chunk_results : results) {
+                for (auto& result : chunk_results) {
+                    if (result.solved)
+                        total_solved++;
+                    if (result.timed_out)
+                        total_timed_out++;
+                    writer.result(std::move(result));
+                }
+            }
+        }
+        if (!error.empty()) {
+            std::cout << error << std::endl;
+            return 1;
+        }
+
+        total = queue_count * jobs_per_chunk;
+        for (size_t i = 0; i < fields.size() && batch; i++) {
+            total_solved += field_solved[i];
+            total_timed_out += field_timed_out[i];
+            writer.field({
+                .index = i,
+                .fumen = fields[i].fumen,
+                .page = fields[i].page + 1,
+                .solved = field_solved[i],
+                .total = queue_count,
+                .timed_out = field_timed_out[i]});
+        }
     }
-    else if(strcmp(vargs[2], "paths") == 0) {
-        size_t total_solved = 0;
-        for (int i = 0; i < queues.size(); i++) {
-            auto pcs = Solver::solve_pcs(board, queues[i]);
-
-            if (pcs.size() == 0) {
-                std::cout << "we could not solve the pc for: " << (i + 1) << std::endl;
-                //std::cout << "the queue is: ";
-                for (const PieceType& piece : queues[i]) {
-                    std::cout << Parser::getChar(piece);
+    else if (strcmp(vargs[2], "percents") == 0) {
+        std::optional<Solver::TilingSolver> tiling;
+        if (engine == "tiling") {
+            tiling.emplace(board, *rules);
+            if (tiling->applicable())
+                writer.note("found " + std::to_string(tiling->tiling_count()) + " tilings!");
+            else
+                tiling.reset();
+        }
+        Solver::SolutionPool pool(board, *rules, pool_size);
+
+        // queues the checkpoint has are only written out again, so the output is the same as a run that was never stopped
+        size_t first = shard_first;
+        if (checkpoint.has_value()) {
+            for (char outcome : checkpoint->outcomes()) {
+                if (first >= queues.size())
+                    break;
+                const bool solved = outcome == Checkpoint::Solved;
+                const bool timed_out = outcome == Checkpoint::TimedOut;
+                if (solved) {
+                    total_solved++;
+                    weighted_solved += chance(first).value_or(0);
                 }
-                std::cout << std::endl << std::endl;
+                if (timed_out)
+                    total_timed_out++;
+                writer.result({.index = first, .queue = queues[first], .solved = solved, .timed_out = timed_out, .probability = chance(first)});
+                first += shard_step;
             }
-            else {
-                std::cout << "solved a thing!" << std::endl;
-                std::cout << "the amount of PCs found is " << pcs.size() << std::endl;
-                for (const auto& path : pcs) {
-                    if (path.size() != 10) {
-                        std::cout << "the path is " << path.size() << " long: " << std::endl;
-
-                        for (const auto& piece : path) {
-                            std::cout << "\t" << Parser::getChar(piece.type) << ": x=" << int(piece.x) << " y=" << int(piece.y) << std::endl;
-                        }
-                        std::cout << std::endl;
+        }
+
+        // what the searches cost, split by answer, to compare move orders
+        Solver::SearchStats solved_searches, unsolved_searches;
+        size_t solved_count = 0, unsolved_count = 0;
+
+        track(queues.size() > first ? (queues.size() - first + shard_step - 1) / shard_step : 0);
+        for (size_t i = first; i < queues.size(); i += shard_step) {
+            if (progress.has_value())
+                progress->start(i);
+            if (cache.has_value()) {
+                if (auto entry = cache->find(board, queues[i], Solver::PC_HEIGHT, CACHE_RULES); entry.has_value()) {
+                    if (entry->solvable) {
+                        total_solved++;
+                        weighted_solved += chance(i).value_or(0);
                     }
+                    writer.result({.index = i, .queue = queues[i], .solved = entry->solvable, .probability = chance(i)});
+                    if (checkpoint.has_value())
+                        checkpoint->add(entry->solvable ? Checkpoint::Solved : Checkpoint::Unsolvable);
+                    if (progress.has_value())
+                        progress->finish(entry->solvable, 0);
+                    continue;
+                }
+            }
+
+            Solver::SearchResult search;
+            if (auto path = pool.applicable() ? pool.find(queues[i], search.stats.nodes) : std::nullopt; path.has_value()) {
+                search.status = Solver::Status::Solved;
+                search.witness = std::move(path);
+            }
+            else {
+                search = tiling.has_value() ? tiling->can_pc(queues[i], limits()) : search_pc(board, queues[i]);
+                if (search.witness.has_value())
+                    pool.add(*search.witness);
+                if (search.status != Solver::Status::TimedOut) {
+                    auto& stats = search.status == Solver::Status::Solved ? solved_searches : unsolved_searches;
+                    stats.nodes += search.stats.nodes;
+                    stats.seconds += search.stats.seconds;
+                    (search.status == Solver::Status::Solved ? solved_count : unsolved_count)++;
                 }
-                std::cout << "number of pcs: " << pcs.size() << std::endl;
-                
+            }
+            bool solved = search.status == Solver::Status::Solved;
+            bool timed_out = search.status == Solver::Status::TimedOut;
+            if (solved) {
+                total_solved++;
+                weighted_solved += chance(i).value_or(0);
+            }
+            if (timed_out)
+                total_timed_out++;
+
+            // a timed out search proved nothing, so it is not worth remembering
+            if (cache.has_value() && !timed_out)
+                cache->insert(board, queues[i], Solver::PC_HEIGHT, CACHE_RULES, {.solvable = solved, .witness = std::move(search.witness)});
+
+            writer.result({.index = i, .queue = queues[i], .solved = solved, .timed_out = timed_out, .probability = chance(i)});
+            if (checkpoint.has_value())
+                checkpoint->add(solved ? Checkpoint::Solved : timed_out ? Checkpoint::TimedOut : Checkpoint::Unsolvable);
+            if (progress.has_value())
+                progress->finish(solved, search.stats.nodes);
+        }
+        if (checkpoint.has_value() && !checkpoint->save())
+            std::cerr << "could not save checkpoint" << std::endl;
+
+        if (pool.applicable() && pool.lookups() > 0)
+            writer.note("solution pool solved " + std::to_string(pool.hits()) + " of " + std::to_string(pool.lookups()) +
+                " searched queues (" + std::to_string(pool.hits() * 100 / pool.lookups()) + "%)");
+        if (!tiling.has_value() && solved_count + unsolved_count > 0) {
+            auto cost = [](const Solver::SearchStats& stats) {
+                std::ostringstream out;
+                out << std::fixed << std::setprecision(3) << stats.seconds << "s / " << stats.nodes << " nodes";
+                return out.str();
+            };
+            writer.note("move order " + std::string(order_name) + ": " + std::to_string(solved_count) + " solved searches took "
+                + cost(solved_searches) + " to the first pc, " + std::to_string(unsolved_count) + " unsolvable took "
+                + cost(unsolved_searches));
+        }
+    }
+    else if(strcmp(vargs[2], "paths") == 0) {
+        track(total);
+        for (size_t i = shard_first; i < queues.size(); i += shard_step) {
+            if (progress.has_value())
+                progress->start(i);
+            auto pcs = Solver::solve_unique_pcs(board, queues[i], limits(), *rules);
+            bool solved = pcs.solutions.size() != 0;
+            bool timed_out = pcs.search.status == Solver::Status::TimedOut;
+            if (solved)
+                total_solved++;
+            if (timed_out)
+                total_timed_out++;
+            if (progress.has_value())
+                progress->finish(solved, pcs.search.stats.nodes);
+
+            writer.result({.index = i, .queue = queues[i], .solved = solved, .timed_out = timed_out, .solutions = std::move(pcs.solutions)});
+        }
+    }
+    else if(strcmp(vargs[2], "count") == 0) {
+        uint64_t total_paths = 0;
+        track(total);
+        for (size_t i = shard_first; i < queues.size(); i += shard_step) {
+            if (progress.has_value())
+                progress->start(i);
+            auto count = Solver::count_pcs(board, queues[i], limits(), *rules);
+            bool solved = count.paths != 0;
+            bool timed_out = count.search.status == Solver::Status::TimedOut;
+            if (solved)
+                total_solved++;
+            if (timed_out)
+                total_timed_out++;
+            total_paths += count.paths;
+            if (progress.has_value())
+                progress->finish(solved, count.search.stats.nodes);
+
+            writer.result({.index = i, .queue = queues[i], .solved = solved, .timed_out = timed_out, .paths = count.paths});
+        }
+        writer.note("pc paths over every queue: " + std::to_string(total_paths));
+    }
+    else if(strcmp(vargs[2], "chain") == 0) {
+        // how many pcs in a row make a chain, every one after the first is on the empty board with what the last one left
+        int stages = 3;
+        if (flag_value(flags, "--stages").has_value()) {
+            auto count = flag_number(flags, "--stages");
+            if (!count.has_value() || *count <= 0 || *count > 16) {
+                std::cout << "--stages expects a number of pcs from 1 to 16" << std::endl;
+                return 1;
+            }
+            stages = int(*count);
+        }
+
+        // the queues, and their chance with --bags, that made at least that many pcs
+        Solver::ChainCache chains;
+        std::vector<size_t> reached(stages + 1);
+        std::vector<double> reached_weight(stages + 1);
+        track(total);
+        for (size_t i = shard_first; i < queues.size(); i += shard_step) {
+            if (progress.has_value())
+                progress->start(i);
+            auto chain = Solver::chain_pcs(board, queues[i], stages, limits(), *rules, options, chains);
+            bool solved = chain.search.status == Solver::Status::Solved;
+            bool timed_out = chain.search.status == Solver::Status::TimedOut;
+            if (solved) {
+                total_solved++;
+                weighted_solved += chance(i).value_or(0);
+            }
+            if (timed_out)
+                total_timed_out++;
+            for (int pcs = 0; pcs <= chain.pcs; pcs++) {
+                reached[pcs]++;
+                reached_weight[pcs] += chance(i).value_or(0);
+            }
+            if (progress.has_value())
+                progress->finish(chain.pcs > 0, chain.search.stats.nodes);
+
+            writer.result({.index = i, .queue = queues[i], .solved = solved, .timed_out = timed_out, .pcs = chain.pcs, .probability = chance(i)});
+        }
+
+        // each stage out of every queue, and out of the queues that got through the stage before it
+        for (int pcs = 1; pcs <= stages && reached[0] != 0; pcs++) {
+            char line[128];
+            if (chances.has_value())
+                std::snprintf(line, sizeof(line), "pc %d: %.4g%% of dealt queues, %.4g%% of the ones that made pc %d", pcs,
+                    reached_weight[pcs] * 100.0, reached_weight[pcs - 1] == 0 ? 0.0 : reached_weight[pcs] / reached_weight[pcs - 1] * 100.0, pcs - 1);
+            else
+                std::snprintf(line, sizeof(line), "pc %d: %zu/%zu = %.4g%%, %.4g%% of the queues that made pc %d", pcs, reached[pcs], reached[0],
+                    reached[pcs] * 100.0 / reached[0], reached[pcs - 1] == 0 ? 0.0 : reached[pcs] * 100.0 / reached[pcs - 1], pcs - 1);
+            // every queue made pc 0, so the first pc only has the first half
+            if (pcs == 1)
+                *std::strchr(line, ',') = '\0';
+            writer.note(line);
+        }
+        writer.note("chains from " + std::to_string(chains.size()) + " leftovers were kept for the empty board");
+    }
+    else if(strcmp(vargs[2], "score") == 0) {
+        track(total);
+        for (size_t i = shard_first; i < queues.size(); i += shard_step) {
+            if (progress.has_value())
+                progress->start(i);
+            auto best = Solver::best_pc(board, queues[i], scorer.value(), *rules);
+            bool solved = best.has_value();
+            if (solved)
+                total_solved++;
+            // best_pc doesn't count its nodes
+            if (progress.has_value())
+                progress->finish(solved, 0);
+
+            Output::QueueResult result{.index = i, .queue = queues[i], .solved = solved, .solutions = std::vector<Solver::Solution>{}};
+            if (solved) {
+                result.solutions->push_back({.path = std::move(best->path), .orderings = 1});
+                result.score = best->score;
+            }
+            writer.result(std::move(result));
+        }
+    }
+    else if(strcmp(vargs[2], "earliest") == 0) {
+        track(total);
+        for (size_t i = shard_first; i < queues.size(); i += shard_step) {
+            if (progress.has_value())
+                progress->start(i);
+            auto earliest = Solver::earliest_pc(board, queues[i], *rules);
+            bool solved = earliest.has_value();
+            if (solved)
                 total_solved++;
+            if (progress.has_value())
+                progress->finish(solved, 0);
+
+            Output::QueueResult result{.index = i, .queue = queues[i], .solved = solved, .solutions = std::vector<Solver::Solution>{}};
+            if (solved) {
+                result.solutions->push_back({.path = std::move(earliest->path), .orderings = 1});
+                result.lines = earliest->lines;
+            }
+            writer.result(std::move(result));
+        }
+    }
+    else if(strcmp(vargs[2], "batch") == 0) {
+        // every (field, queue) pair is one job, so a few slow fields don't leave threads idle
+        struct Counts {
+            std::atomic<size_t> solved = 0;
+            std::atomic<size_t> timed_out = 0;
+        };
+        std::vector<Counts> counts(fields.size());
+
+        total = fields.size() * queues.size();
+        track(total);
+
+        ThreadPool pool(threads);
+        pool.for_each_index(total, [&](size_t i) {
+            const Board& field = fields[i / queues.size()].board;
+            const Queue& queue = queues[i % queues.size()];
+            Counts& count = counts[i / queues.size()];
+            if (progress.has_value())
+                progress->start(i);
+
+            auto search = solve(field, queue);
+            if (search.status == Solver::Status::Solved)
+                count.solved++;
+            if (search.status == Solver::Status::TimedOut)
+                count.timed_out++;
+            if (progress.has_value())
+                progress->finish(search.status == Solver::Status::Solved, search.stats.nodes);
+        });
+
+        for (size_t i = 0; i < fields.size(); i++) {
+            total_solved += counts[i].solved;
+            total_timed_out += counts[i].timed_out;
+            writer.field({
+                .index = i,
+                .fumen = fields[i].fumen,
+                .page = fields[i].page + 1,
+                .solved = counts[i].solved,
+                .total = queues.size(),
+                .timed_out = counts[i].timed_out});
+        }
+    }
+    else if (strcmp(vargs[2], "compare") == 0) {
+        // the fields are searched side by side, queue by queue, and a field is dropped once even solving every queue
+        // it has left can't bring it up to what the best field already has for sure
+        struct Standing {
+            size_t solved = 0;
+            size_t searched = 0;
+            size_t timed_out = 0;
+            // the chance of the solved, searched and timed out queues with --bags, otherwise how many there are
+            double solved_weight = 0;
+            double searched_weight = 0;
+            double timed_out_weight = 0;
+            // the best the field could still do when it was dropped
+            std::optional<double> max_weight;
+        };
+        const double total_weight = chances.has_value() ? std::accumulate(chances->begin(), chances->end(), 0.0) : double(queues.size());
+        // sums of chances pick up rounding, so being just under the best is not enough to drop a field
+        const double tolerance = total_weight * 1e-9;
+        std::vector<Standing> standings(fields.size());
+        std::mutex standings_mutex;
+        double best_solved_weight = 0;
+
+        total = fields.size() * queues.size();
+        track(total);
+
+        ThreadPool pool(threads);
+        pool.for_each_index(total, [&](size_t i) {
+            const size_t field = i % fields.size();
+            const size_t queue = i / fields.size();
+            {
+                std::lock_guard lock(standings_mutex);
+                if (standings[field].max_weight.has_value())
+                    return;
             }
+            if (progress.has_value())
+                progress->start(i);
+            auto search = solve(fields[field].board, queues[queue]);
+            const bool solved = search.status == Solver::Status::Solved;
+            const bool timed_out = search.status == Solver::Status::TimedOut;
+            if (progress.has_value())
+                progress->finish(solved, search.stats.nodes);
 
+            const double weight = chance(queue).value_or(1);
+            std::lock_guard lock(standings_mutex);
+            Standing& standing = standings[field];
+            standing.searched++;
+            standing.searched_weight += weight;
+            if (solved) {
+                standing.solved++;
+                standing.solved_weight += weight;
+                best_solved_weight = std::max(best_solved_weight, standing.solved_weight);
+            }
+            if (timed_out) {
+                standing.timed_out++;
+                standing.timed_out_weight += weight;
+            }
+
+            // a timed out queue might still pc, so it counts for the best case like the queues not searched yet
+            for (Standing& other : standings) {
+                const double max_weight = other.solved_weight + other.timed_out_weight + (total_weight - other.searched_weight);
+                if (!other.max_weight.has_value() && max_weight < best_solved_weight - tolerance)
+                    other.max_weight = max_weight;
+            }
+        });
+
+        // fields searched to the end by their percent, then the dropped ones by how well they could have done
+        std::vector<size_t> ranking(fields.size());
+        std::iota(ranking.begin(), ranking.end(), 0);
+        std::stable_sort(ranking.begin(), ranking.end(), [&](size_t a, size_t b) {
+            const Standing& first = standings[a];
+            const Standing& second = standings[b];
+            if (first.max_weight.has_value() != second.max_weight.has_value())
+                return !first.max_weight.has_value();
+            return first.max_weight.value_or(first.solved_weight) > second.max_weight.value_or(second.solved_weight);
+        });
+
+        size_t dropped = 0;
+        size_t searched = 0;
+        for (size_t rank = 0; rank < ranking.size(); rank++) {
+            const size_t i = ranking[rank];
+            const Standing& standing = standings[i];
+            total_solved += standing.solved;
+            total_timed_out += standing.timed_out;
+            searched += standing.searched;
+            if (standing.max_weight.has_value())
+                dropped++;
+            writer.field({
+                .index = i,
+                .fumen = fields[i].fumen,
+                .page = fields[i].page + 1,
+                .solved = standing.solved,
+                .total = queues.size(),
+                .timed_out = standing.timed_out,
+                .weighted_percentage = chances.has_value() ? std::optional(standing.solved_weight * 100.0) : std::nullopt,
+                .rank = rank + 1,
+                .searched = standing.searched,
+                .max_percentage = standing.max_weight.has_value() ? std::optional(*standing.max_weight / total_weight * 100.0) : std::nullopt});
         }
-        std::cout << "solved/total: " << total_solved  << "/" << queues.size() << std::endl;
+        writer.note("dropped " + std::to_string(dropped) + " of " + std::to_string(fields.size()) + " fields early, searched "
+            + std::to_string(searched) + " of " + std::to_string(total) + " queues");
+        total = searched;
     }
     	else {
-		std::cout << "Usage: ./" << args[0] << " <fumen> <paths|percents> <queue>" << std::endl;
+		print_usage(args[0]);
 		return 1;
 	}
 
+    // the last report goes out before the summary
+    progress.reset();
+    if (dead_cache.has_value() && dead_cache->stats().lookups != 0) {
+        const auto stats = dead_cache->stats();
+        writer.note("dead state cache: " + std::to_string(stats.hits) + " hits of " + std::to_string(stats.lookups) + " lookups, "
+            + std::to_string(stats.pruned) + " dead, " + std::to_string(stats.entries) + " states kept, " + std::to_string(stats.evictions) + " dropped");
+    }
     auto end = std::chrono::steady_clock::now();
 
-    std::cout << "Time difference = " << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 1e9 << "[seconds]" << std::endl;
+    writer.summary({
+        .solved = total_solved,
+        .total = total,
+        .timed_out = total_timed_out,
+        .seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / 1e9,
+        .weighted_percentage = chances.has_value() ? std::optional(weighted_solved * 100.0) : std::nullopt,
+        .pattern_total = flag_value(flags, "--shard").has_value() ? std::optional(queues.size()) : std::nullopt});
 
     return 0;
 }
\ No newline at end of file
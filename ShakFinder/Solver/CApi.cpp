@@ -0,0 +1,305 @@
+#include "CApi.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Fumen.hpp"
+#include "Nogood.hpp"
+#include "Parser.hpp"
+#include "ResultCache.hpp"
+#include "Rules.hpp"
+#include "Solver.hpp"
+#include "ThreadPool.hpp"
+#include "Util.hpp"
+
+struct shakfinder_context {
+    explicit shakfinder_context(const shakfinder_options& options)
+        : timeout(options.timeout_ms), rules(Rules::Id(options.rules)), pool(options.threads),
+          nogoods(options.dead_cache_mb != 0 ? size_t(options.dead_cache_mb) << 20 : Solver::NogoodCache::DEFAULT_BYTES) {}
+
+    Solver::SearchLimits limits() const {
+        Solver::SearchLimits limits;
+        if (timeout.count() > 0)
+            limits.deadline = std::chrono::steady_clock::now() + timeout;
+        return limits;
+    }
+
+    std::chrono::milliseconds timeout;
+    Rules::Id rules;
+    ThreadPool pool;
+    // shared by every can_pc of the context, on whatever board, it locks itself
+    Solver::NogoodCache nogoods;
+
+    std::mutex cache_mutex;
+    std::optional<ResultCache> cache;
+
+    // the last pattern expanded, bots tend to ask about the same pattern on many fields
+    std::string pattern;
+    std::vector<Queue> queues;
+};
+
+static Board to_board(const shakfinder_board& in) {
+    Board board;
+    for (int y = 0; y < SHAKFINDER_BOARD_HEIGHT; ++y)
+        for (int x = 0; x < 10; ++x)
+            if (in.rows[y] >> x & 1)
+                board.set(x, y);
+    return board;
+}
+
+static shakfinder_board from_board(const Board& board) {
+    shakfinder_board out{};
+    auto rows = board_rows(board);
+    std::copy_n(rows.begin(), SHAKFINDER_BOARD_HEIGHT, out.rows);
+    return out;
+}
+
+static std::optional<Queue> to_queue(const char* text) {
+    Queue queue;
+    for (; *text != '\0'; ++text) {
+        PieceType piece = Parser::getType(*text);
+        if (piece == PieceType::Empty)
+            return std::nullopt;
+        queue.push_back(piece);
+    }
+    return queue;
+}
+
+static shakfinder_placement from_piece(const FullPiece& piece) {
+    return {.type = (char)piece.type, .x = piece.x, .y = piece.y, .rotation = piece.r};
+}
+
+static shakfinder_status from_status(Solver::Status status) {
+    switch (status) {
+    case Solver::Status::Solved:
+        return SHAKFINDER_SOLVED;
+    case Solver::Status::TimedOut:
+        return SHAKFINDER_TIMED_OUT;
+    default:
+        return SHAKFINDER_UNSOLVABLE;
+    }
+}
+
+// nothing may unwind through the c boundary
+template <typename F>
+static shakfinder_error guarded(F&& f) {
+    try {
+        return f();
+    }
+    catch (...) {
+        return SHAKFINDER_INTERNAL_ERROR;
+    }
+}
+
+extern "C" {
+
+uint32_t shakfinder_abi_version(void) {
+    return SHAKFINDER_ABI_VERSION;
+}
+
+shakfinder_context* shakfinder_context_create(const shakfinder_options* options) {
+    if (options != nullptr && options->rules > SHAKFINDER_RULES_SRS180_NOHOLD)
+        return nullptr;
+    try {
+        auto* context = new shakfinder_context(options != nullptr ? *options : shakfinder_options{});
+        if (options != nullptr && options->cache_path != nullptr) {
+            context->cache.emplace(options->cache_path);
+            if (!context->cache->is_open()) {
+                delete context;
+                return nullptr;
+            }
+        }
+        return context;
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void shakfinder_context_destroy(shakfinder_context* context) {
+    delete context;
+}
+
+shakfinder_error shakfinder_decode_fumen(const char* fumen, shakfinder_board* boards, size_t capacity, size_t* page_count) {
+    if (fumen == nullptr || page_count == nullptr || (boards == nullptr && capacity != 0))
+        return SHAKFINDER_INVALID_ARGUMENT;
+
+    return guarded([&] {
+        auto decoded = Fumen::parse(fumen);
+        if (!decoded.has_value())
+            return SHAKFINDER_PARSE_FAILED;
+
+        const auto& pages = decoded->pages;
+        *page_count = pages.size();
+        for (size_t i = 0; i < pages.size() && i < capacity; ++i)
+            boards[i] = from_board(Fumen::to_board(pages[i].field));
+        return pages.size() <= capacity ? SHAKFINDER_OK : SHAKFINDER_BUFFER_TOO_SMALL;
+    });
+}
+
+shakfinder_error shakfinder_parse_pattern(const char* pattern, char* queues, size_t capacity, size_t* queue_count, size_t* size) {
+    if (pattern == nullptr || queue_count == nullptr || size == nullptr || (queues == nullptr && capacity != 0))
+        return SHAKFINDER_INVALID_ARGUMENT;
+
+    return guarded([&] {
+        auto parsed = Parser::parse(Parser::preprocess(pattern));
+        if (parsed.empty())
+            return SHAKFINDER_PARSE_FAILED;
+
+        size_t needed = 0;
+        for (const Queue& queue : parsed)
+            needed += queue.size() + 1;
+        *queue_count = parsed.size();
+        *size = needed;
+        if (needed > capacity)
+            return SHAKFINDER_BUFFER_TOO_SMALL;
+
+        for (const Queue& queue : parsed) {
+            for (PieceType piece : queue)
+                *queues++ = Parser::getChar(piece);
+            *queues++ = '\0';
+        }
+        return SHAKFINDER_OK;
+    });
+}
+
+shakfinder_error shakfinder_can_pc(shakfinder_context* context, const shakfinder_board* board, const char* queue,
+    shakfinder_status* status, shakfinder_placement* witness, size_t witness_capacity, size_t* witness_length) {
+    if (context == nullptr || board == nullptr || queue == nullptr || status == nullptr || (witness == nullptr && witness_capacity != 0))
+        return SHAKFINDER_INVALID_ARGUMENT;
+
+    return guarded([&] {
+        auto pieces = to_queue(queue);
+        if (!pieces.has_value())
+            return SHAKFINDER_PARSE_FAILED;
+        Board field = to_board(*board);
+
+        std::optional<std::vector<FullPiece>> path;
+        std::optional<ResultCache::Entry> cached;
+        if (context->cache.has_value()) {
+            std::lock_guard lock(context->cache_mutex);
+            cached = context->cache->find(field, *pieces, Solver::PC_HEIGHT, uint8_t(context->rules));
+        }
+
+        if (cached.has_value()) {
+            *status = cached->solvable ? SHAKFINDER_SOLVED : SHAKFINDER_UNSOLVABLE;
+            path = std::move(cached->witness);
+        }
+        else {
+            auto search = Solver::can_pc(field, *pieces, context->limits(), context->rules, Solver::SearchOptions{.nogoods = &context->nogoods});
+            *status = from_status(search.status);
+            if (context->cache.has_value() && search.status != Solver::Status::TimedOut) {
+                std::lock_guard lock(context->cache_mutex);
+                context->cache->insert(field, *pieces, Solver::PC_HEIGHT, uint8_t(context->rules),
+                    {.solvable = search.status == Solver::Status::Solved, .witness = search.witness});
+            }
+            path = std::move(search.witness);
+        }
+
+        if (witness_length == nullptr)
+            return SHAKFINDER_OK;
+        // the cache can hold solvable entries without a path
+        *witness_length = path.has_value() ? path->size() : 0;
+        if (*witness_length > witness_capacity)
+            return SHAKFINDER_BUFFER_TOO_SMALL;
+        if (path.has_value())
+            std::transform(path->begin(), path->end(), witness, from_piece);
+        return SHAKFINDER_OK;
+    });
+}
+
+shakfinder_error shakfinder_solve_pcs(shakfinder_context* context, const shakfinder_board* board, const char* queue,
+    shakfinder_status* status, shakfinder_placement* placements, size_t placements_capacity,
+    size_t* lengths, size_t lengths_capacity, size_t* solution_count, size_t* placement_count) {
+    if (context == nullptr || board == nullptr || queue == nullptr || status == nullptr
+        || solution_count == nullptr || placement_count == nullptr
+        || (placements == nullptr && placements_capacity != 0) || (lengths == nullptr && lengths_capacity != 0))
+        return SHAKFINDER_INVALID_ARGUMENT;
+
+    return guarded([&] {
+        auto pieces = to_queue(queue);
+        if (!pieces.has_value())
+            return SHAKFINDER_PARSE_FAILED;
+
+        auto result = Solver::solve_pcs(to_board(*board), *pieces, context->limits(), context->rules);
+        *status = result.solutions.empty() ? from_status(result.search.status) : SHAKFINDER_SOLVED;
+
+        size_t needed = 0;
+        for (const auto& solution : result.solutions)
+            needed += solution.path.size();
+        *solution_count = result.solutions.size();
+        *placement_count = needed;
+        if (needed > placements_capacity || result.solutions.size() > lengths_capacity)
+            return SHAKFINDER_BUFFER_TOO_SMALL;
+
+        for (const auto& solution : result.solutions) {
+            *lengths++ = solution.path.size();
+            placements = std::transform(solution.path.begin(), solution.path.end(), placements, from_piece);
+        }
+        return SHAKFINDER_OK;
+    });
+}
+
+shakfinder_error shakfinder_percent(shakfinder_context* context, const shakfinder_board* board, const char* pattern,
+    size_t* solved, size_t* total, size_t* timed_out) {
+    if (context == nullptr || board == nullptr || pattern == nullptr || solved == nullptr || total == nullptr)
+        return SHAKFINDER_INVALID_ARGUMENT;
+
+    return guarded([&] {
+        if (context->queues.empty() || context->pattern != pattern) {
+            context->queues = Parser::parse(Parser::preprocess(pattern));
+            context->pattern = context->queues.empty() ? "" : pattern;
+        }
+        if (context->queues.empty())
+            return SHAKFINDER_PARSE_FAILED;
+
+        const Board field = to_board(*board);
+        std::atomic<size_t> solved_count = 0;
+        std::atomic<size_t> timed_out_count = 0;
+        context->pool.for_each_index(context->queues.size(), [&](size_t i) {
+            const Queue& queue = context->queues[i];
+            if (context->cache.has_value()) {
+                std::lock_guard lock(context->cache_mutex);
+                if (auto entry = context->cache->find(field, queue, Solver::PC_HEIGHT, uint8_t(context->rules)); entry.has_value()) {
+                    if (entry->solvable)
+                        solved_count++;
+                    return;
+                }
+            }
+
+            Solver::SearchResult search;
+            try {
+                search = Solver::can_pc(field, queue, context->limits(), context->rules, Solver::SearchOptions{.nogoods = &context->nogoods});
+            }
+            catch (...) {
+                // counted as not finished rather than tearing down the pool
+                search.status = Solver::Status::TimedOut;
+            }
+            if (search.status == Solver::Status::Solved)
+                solved_count++;
+            if (search.status == Solver::Status::TimedOut) {
+                timed_out_count++;
+                return;
+            }
+
+            if (context->cache.has_value()) {
+                std::lock_guard lock(context->cache_mutex);
+                context->cache->insert(field, queue, Solver::PC_HEIGHT, uint8_t(context->rules),
+                    {.solvable = search.status == Solver::Status::Solved, .witness = std::move(search.witness)});
+            }
+        });
+
+        *solved = solved_count;
+        *total = context->queues.size();
+        if (timed_out != nullptr)
+            *timed_out = timed_out_count;
+        return SHAKFINDER_OK;
+    });
+}
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+// c interface to the solver, for bots that want to call it in process instead of running the executable
+// results are written into buffers the caller owns, nothing returned ever has to be freed by the caller
+// a context is used by one thread at a time, separate contexts share nothing and can run in parallel
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// bumped whenever a struct layout or a function signature changes
+#define SHAKFINDER_ABI_VERSION 3
+
+#define SHAKFINDER_BOARD_HEIGHT 24
+
+typedef enum shakfinder_error {
+    SHAKFINDER_OK = 0,
+    SHAKFINDER_INVALID_ARGUMENT = 1,
+    // the fumen, pattern or queue could not be read
+    SHAKFINDER_PARSE_FAILED = 2,
+    // an output buffer was too small, the sizes that would have been needed are still reported
+    SHAKFINDER_BUFFER_TOO_SMALL = 3,
+    SHAKFINDER_INTERNAL_ERROR = 4,
+} shakfinder_error;
+
+// the same values as the executable's --rules
+typedef enum shakfinder_rules {
+    SHAKFINDER_RULES_SRS = 0,
+    SHAKFINDER_RULES_SRS180 = 1,
+    SHAKFINDER_RULES_SRS_NOHOLD = 2,
+    SHAKFINDER_RULES_SRS180_NOHOLD = 3,
+} shakfinder_rules;
+
+typedef enum shakfinder_status {
+    SHAKFINDER_SOLVED = 0,
+    SHAKFINDER_UNSOLVABLE = 1,
+    // the context's timeout passed before the search finished
+    SHAKFINDER_TIMED_OUT = 2,
+} shakfinder_status;
+
+// rows[0] is the bottom row, bit x of a row is column x
+typedef struct shakfinder_board {
+    uint16_t rows[SHAKFINDER_BOARD_HEIGHT];
+} shakfinder_board;
+
+// type is one of the letters SZIOLJT, rotation is 0 north, 1 east, 2 south, 3 west
+// x and y are the rotation center, the same coordinates the executable prints
+typedef struct shakfinder_placement {
+    char type;
+    int8_t x;
+    int8_t y;
+    int8_t rotation;
+} shakfinder_placement;
+
+typedef struct shakfinder_options {
+    // threads shakfinder_percent spreads its queues over, 0 for one per core
+    uint32_t threads;
+    // time limit of every single search in milliseconds, 0 for none
+    uint32_t timeout_ms;
+    // result cache file, the same format as the executable's --cache, null for none
+    const char* cache_path;
+    // a shakfinder_rules value
+    uint32_t rules;
+    // memory for the states the context's searches have proven have no pc, in megabytes, 0 for the default of 64
+    // it is kept for the life of the context, so every board and queue asked about shares it like the executable's --dead-cache-mb
+    uint32_t dead_cache_mb;
+} shakfinder_options;
+
+typedef struct shakfinder_context shakfinder_context;
+
+uint32_t shakfinder_abi_version(void);
+
+// options can be null for the defaults, returns null if the cache could not be opened or the rules are unknown
+shakfinder_context* shakfinder_context_create(const shakfinder_options* options);
+void shakfinder_context_destroy(shakfinder_context* context);
+
+// decodes every page of a fumen into boards
+// at most capacity boards are written, page_count is set to the number of pages either way
+shakfinder_error shakfinder_decode_fumen(const char* fumen, shakfinder_board* boards, size_t capacity, size_t* page_count);
+
+// expands a pattern like "[SZ]p2,*p4" into its queues, written back to back as piece letters each ending in a 0
+// queue_count is set to the number of queues and size to the bytes all of them need
+shakfinder_error shakfinder_parse_pattern(const char* pattern, char* queues, size_t capacity, size_t* queue_count, size_t* size);
+
+// queue is a 0 terminated string of piece letters, the first one being the current piece
+// witness and witness_length can be null, otherwise witness gets the path of the pc that was found
+shakfinder_error shakfinder_can_pc(shakfinder_context* context, const shakfinder_board* board, const char* queue,
+    shakfinder_status* status, shakfinder_placement* witness, size_t witness_capacity, size_t* witness_length);
+
+// finds every distinct pc, their paths are written back to back into placements and the length of each path into lengths
+// solution_count and placement_count are set to what all of them need
+shakfinder_error shakfinder_solve_pcs(shakfinder_context* context, const shakfinder_board* board, const char* queue,
+    shakfinder_status* status, shakfinder_placement* placements, size_t placements_capacity,
+    size_t* lengths, size_t lengths_capacity, size_t* solution_count, size_t* placement_count);
+
+// runs can_pc on every queue of the pattern using the context's threads, like the executable's percents mode
+// timed_out can be null
+shakfinder_error shakfinder_percent(shakfinder_context* context, const shakfinder_board* board, const char* pattern,
+    size_t* solved, size_t* total, size_t* timed_out);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,83 @@
+#include "Chain.hpp"
+
+#include <algorithm>
+
+namespace Solver {
+    namespace {
+        std::string chain_key(const Queue& leftover) {
+            return std::string(leftover.begin(), leftover.end());
+        }
+
+        struct ChainSearch {
+            const SearchLimits& limits;
+            Rules::Id rules;
+            const SearchOptions& options;
+            ChainCache& cache;
+            uint64_t nodes = 0;
+            bool timed_out = false;
+
+            int longest(const Board& board, const Queue& queue, int stages, bool empty_board) {
+                if (stages == 0 || queue.empty())
+                    return 0;
+                if (empty_board) {
+                    if (auto known = cache.find(queue, stages); known.has_value())
+                        return *known;
+                }
+
+                // the search stops at the first pc whose leftover makes the rest of the chain
+                int best = 0;
+                auto search = can_pc_then(board, queue, limits, rules, options, [&](const Queue& leftover) {
+                    best = std::max(best, 1);
+                    if (stages > 1)
+                        best = std::max(best, 1 + longest(Board{}, leftover, stages - 1, true));
+                    return best == stages;
+                });
+                nodes += search.stats.nodes;
+                if (search.status == Status::TimedOut)
+                    timed_out = true;
+
+                // a chain that ran out of time somewhere may be longer than it looks
+                if (empty_board && !timed_out)
+                    cache.insert(queue, stages, best);
+                return best;
+            }
+        };
+    }
+
+    std::optional<int> ChainCache::find(const Queue& leftover, int stages) {
+        std::lock_guard lock(mutex);
+        auto it = chains.find(chain_key(leftover));
+        if (it == chains.end())
+            return std::nullopt;
+        // a chain cut off at its stages says nothing about chains longer than that
+        const Entry& entry = it->second;
+        if (entry.pcs < entry.stages || stages <= entry.stages)
+            return std::min(entry.pcs, stages);
+        return std::nullopt;
+    }
+
+    void ChainCache::insert(const Queue& leftover, int stages, int pcs) {
+        std::lock_guard lock(mutex);
+        Entry& entry = chains[chain_key(leftover)];
+        if (stages > entry.stages)
+            entry = {.stages = stages, .pcs = pcs};
+    }
+
+    size_t ChainCache::size() {
+        std::lock_guard lock(mutex);
+        return chains.size();
+    }
+
+    ChainResult chain_pcs(const Board& board, const Queue& queue, int stages, const SearchLimits& limits, Rules::Id rules,
+            const SearchOptions& options, ChainCache& cache) {
+        const auto start = std::chrono::steady_clock::now();
+        ChainSearch search{.limits = limits, .rules = rules, .options = options, .cache = cache};
+        const int pcs = search.longest(board, queue, stages, !board.any());
+
+        ChainResult result{.pcs = pcs};
+        result.search.status = pcs == stages ? Status::Solved : search.timed_out ? Status::TimedOut : Status::Unsolvable;
+        result.search.stats.nodes = search.nodes;
+        result.search.stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "Rules.hpp"
+#include "Solver.hpp"
+#include "Util.hpp"
+
+namespace Solver {
+    struct ChainResult {
+        // pcs in a row, the first on the field and every one after it on the empty board, at most the stages asked for
+        int pcs = 0;
+        // the nodes and time of every search of the chain, timed out if any of them was cut short
+        SearchResult search;
+    };
+
+    // how long a chain every leftover makes on the empty board
+    // every pc after the first starts on the empty board, so this holds for every queue and field of a run
+    // and the same leftovers come up over and over, safe to use from any thread
+    class ChainCache {
+    public:
+        // the chain the leftover makes with up to stages pcs, if it is known
+        std::optional<int> find(const Queue& leftover, int stages);
+        void insert(const Queue& leftover, int stages, int pcs);
+
+        size_t size();
+
+    private:
+        struct Entry {
+            // the stages the search was allowed and the pcs it found, fewer pcs than stages is the longest chain there is
+            int stages = 0;
+            int pcs = 0;
+        };
+
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> chains;
+    };
+
+    // the longest run of pcs, up to stages of them, the queue makes starting from board
+    // every pc goes on with what the one before it left over, the held piece included, see can_pc_then
+    ChainResult chain_pcs(const Board& board, const Queue& queue, int stages, const SearchLimits& limits, Rules::Id rules,
+        const SearchOptions& options, ChainCache& cache);
+};
@@ -0,0 +1,127 @@
+#include "Checkpoint.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr std::string_view HEADER = "shakfinder checkpoint 1";
+}
+
+Checkpoint::Checkpoint(std::string path, uint64_t run)
+    : path(std::move(path)), run(run), last_save(std::chrono::steady_clock::now()) {}
+
+bool Checkpoint::load(std::string& error) {
+    error.clear();
+    std::ifstream file(path);
+    if (!file)
+        return false;
+
+    std::string header, key;
+    uint64_t saved_run = 0;
+    size_t count = 0, solved = 0, timed_out = 0;
+    std::string outcomes;
+    std::getline(file, header);
+    file >> key >> std::hex >> saved_run >> std::dec;
+    file >> key >> count >> key >> solved >> key >> timed_out >> key >> outcomes;
+    if (outcomes == "-")
+        outcomes.clear();
+
+    // the counts are written out for people reading the file, they also catch a checkpoint that was cut short
+    if (header != HEADER || file.fail() || outcomes.size() != count ||
+        (size_t)std::count(outcomes.begin(), outcomes.end(), Solved) != solved ||
+        (size_t)std::count(outcomes.begin(), outcomes.end(), TimedOut) != timed_out) {
+        error = "could not read checkpoint " + path;
+        return false;
+    }
+    if (saved_run != run) {
+        error = "checkpoint " + path + " is from a different run";
+        return false;
+    }
+
+    done = std::move(outcomes);
+    return true;
+}
+
+void Checkpoint::add(Outcome outcome) {
+    done.push_back(char(outcome));
+
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_save >= std::max<std::chrono::steady_clock::duration>(INTERVAL, save_cost * 100))
+        save();
+}
+
+bool Checkpoint::save() {
+    const auto start = std::chrono::steady_clock::now();
+    const std::string temporary = path + ".tmp";
+
+    std::ostringstream text;
+    text << HEADER << "\n";
+    text << "run " << std::hex << run << std::dec << "\n";
+    text << "completed " << done.size() << "\n";
+    text << "solved " << std::count(done.begin(), done.end(), Solved) << "\n";
+    text << "timed_out " << std::count(done.begin(), done.end(), TimedOut) << "\n";
+    // an empty run still needs something after the key to read back
+    text << "outcomes " << (done.empty() ? "-" : done) << "\n";
+    const std::string contents = text.str();
+
+    bool saved = false;
+#ifndef _WIN32
+    // the new file has to be on disk before it is renamed over the old one, or a crash right after the rename
+    // can leave an empty checkpoint behind, and the rename has to be on disk before the old outcomes are gone for good
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        size_t written = 0;
+        while (written < contents.size()) {
+            const ssize_t n = ::write(fd, contents.data() + written, contents.size() - written);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            written += size_t(n);
+        }
+        const bool synced = written == contents.size() && ::fsync(fd) == 0;
+        saved = ::close(fd) == 0 && synced && ::rename(temporary.c_str(), path.c_str()) == 0;
+        if (saved) {
+            const std::filesystem::path directory = std::filesystem::absolute(path).parent_path();
+            const int directory_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+            if (directory_fd >= 0) {
+                ::fsync(directory_fd);
+                ::close(directory_fd);
+            }
+        }
+    }
+#else
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file << contents;
+        file.close();
+        saved = !file.fail();
+    }
+    std::error_code error;
+    if (saved)
+        std::filesystem::rename(temporary, path, error);
+    saved = saved && !error;
+#endif
+
+    last_save = std::chrono::steady_clock::now();
+    save_cost = last_save - start;
+    return saved;
+}
+
+uint64_t Checkpoint::fingerprint(std::string_view text) {
+    // fnv-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : text) {
+        hash ^= (unsigned char)c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// progress of a long percents run, so a job that was killed can pick up where it stopped
+// the queues are done in order, so the progress is how many are done and what came out of each of them
+// saving writes a temporary file and renames it over the old one, so a crash leaves either the old or the new checkpoint
+class Checkpoint {
+public:
+    enum Outcome : char {
+        Solved = 's',
+        Unsolvable = 'u',
+        TimedOut = 't',
+    };
+
+    // run identifies the field, pattern and everything else that changes the results, see fingerprint
+    Checkpoint(std::string path, uint64_t run);
+
+    // reads back what an earlier process of the same run saved, false with an empty error if nothing was saved yet
+    bool load(std::string& error);
+
+    // the outcome of every queue done so far, in the order they were done
+    const std::string& outcomes() const { return done; }
+
+    // records the next queue and saves when it is due
+    void add(Outcome outcome);
+
+    bool save();
+
+    static uint64_t fingerprint(std::string_view text);
+
+private:
+    std::string path;
+    uint64_t run;
+    std::string done;
+
+    // saves are spaced out so they take at most 1% of the time, and happen at least every interval
+    static constexpr std::chrono::seconds INTERVAL{10};
+    std::chrono::steady_clock::time_point last_save;
+    std::chrono::steady_clock::duration save_cost{};
+};
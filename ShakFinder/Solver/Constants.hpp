@@ -0,0 +1,12 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+enum class Spin : uint8_t {
+    null,
+    mini,
+    normal,
+};
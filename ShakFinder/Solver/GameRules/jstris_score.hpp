@@ -3,12 +3,19 @@
 #include "tetris_points.hpp"
 
 
-class JstrisScore : public Points {
+class JstrisScore final : public Points {
 public:
 	
 	virtual int calculate(PieceStats stats) override {
 		return jstris_score(stats, state);
 	}
+
+	virtual int remaining_bound(int pieces_left, int lines_left) const override {
+		// no clear is worth more than a b2b t-spin single per line, every clearing piece
+		// can at most extend the combo, and the pc bonus is paid once at the end
+		const int clears = std::min(pieces_left, lines_left);
+		return 1200 * lines_left + 50 * clears * (state.combo + clears) + 3000;
+	}
 	
 private:
 
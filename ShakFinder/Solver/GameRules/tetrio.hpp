@@ -37,13 +37,26 @@ constexpr struct tetrio_settings {
 } game_settings;
 
 
-class tetrio_points : public Points {
+class tetrio_points final : public Points {
 public:
 
     virtual int calculate(PieceStats stats) override {
 		return tetrio_damage(stats, state);
 	}
 
+    virtual int remaining_bound(int pieces_left, int lines_left) const override {
+        // no clear sends more than 3 lines of garbage per line cleared, the b2b bonus and the combo
+        // multiplier are taken at the longest chain the remaining pieces could build
+        const int clears = std::min(pieces_left, lines_left);
+        const int combo = state.combo + clears;
+        const int b2b = state.b2b + clears;
+        const float b2b_bonus = GarbageValues::BACKTOBACK_BONUS * (2 + std::log1p(b2b * GarbageValues::BACKTOBACK_BONUS_LOG));
+        const float multiplier = 1 + GarbageValues::COMBO_BONUS * combo;
+        const float combo_floor = std::log1p(GarbageValues::COMBO_MINIFIER * combo * GarbageValues::COMBO_MINIFIER_LOG);
+        const float garbage = (3 * lines_left + clears * b2b_bonus) * multiplier + clears * combo_floor;
+        return int(std::ceil(garbage)) * game_settings.garbagemultiplier + GarbageValues::ALL_CLEAR;
+    }
+
 private:
 
     struct TetrioStats {
@@ -14,5 +14,7 @@ struct PieceStats {
 class Points {
 public:
     virtual int calculate(PieceStats stats) = 0;
+    // an upper bound on the points the rest of a pc can still score, used to prune the search
+    virtual int remaining_bound(int pieces_left, int lines_left) const = 0;
     virtual ~Points() = default;
 };
@@ -0,0 +1,22 @@
+#include "Movegen.hpp"
+
+#include <algorithm>
+
+namespace Solver {
+    // a map entry with its node and bucket, roughly
+    constexpr size_t ENTRY_BYTES = sizeof(Board) + sizeof(PieceType) + sizeof(Moves) + 32;
+
+    MovegenCache::MovegenCache(Rules::Id rules, size_t max_bytes)
+        : rules(rules), max_entries(std::max<size_t>(max_bytes / ENTRY_BYTES, 1)) {}
+
+    const Moves& MovegenCache::moves(const Board& board, PieceType piece) {
+        const Key key{board, piece};
+        if (auto it = cache.find(key); it != cache.end())
+            return it->second;
+
+        if (cache.size() >= max_entries)
+            cache.clear();
+        auto [it, inserted] = cache.try_emplace(key, Rules::visit(rules, [&]<typename R>() { return Game::piece_movegen<R>(board, piece); }));
+        return it->second;
+    }
+};
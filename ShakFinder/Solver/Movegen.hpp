@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+
+#include "Rules.hpp"
+#include "Util.hpp"
+
+namespace Solver {
+    using Moves = decltype(Game::piece_movegen(Board{}, PieceType::T));
+
+    // remembers the reachability boards of every (board, piece) it has generated under one ruleset
+    // it keeps the unbounded movegen so the same entry serves every line limit
+    // a cache is for one thread, once it holds max_bytes worth of boards it is emptied and starts over
+    class MovegenCache {
+    public:
+        explicit MovegenCache(Rules::Id rules, size_t max_bytes = DEFAULT_BYTES);
+
+        // only valid until the next call
+        const Moves& moves(const Board& board, PieceType piece);
+
+        // the movegen for the current or the hold piece, in the shape for_each_child takes
+        Moves operator()(const Game& game, bool held, int) {
+            const PieceType piece = held ? game.hold.value_or(game.queue.front()) : game.current_piece;
+            if (piece == PieceType::Empty || (held && piece == game.current_piece)) {
+                // no moves possible, empty return
+                return Moves{std::span<Board, 0>()};
+            }
+            return moves(game.board, piece);
+        }
+
+        size_t size() const { return cache.size(); }
+
+        static constexpr size_t DEFAULT_BYTES = 16 << 20;
+
+    private:
+        struct Key {
+            Board board;
+            PieceType piece;
+        };
+        struct KeyHash {
+            size_t operator()(const Key& key) const noexcept {
+                return BoardHash{}(key.board) ^ (size_t(key.piece) * 0x9e3779b97f4a7c15ULL);
+            }
+        };
+        struct KeyEqual {
+            bool operator()(const Key& a, const Key& b) const noexcept {
+                return a.piece == b.piece && BoardEqual{}(a.board, b.board);
+            }
+        };
+
+        Rules::Id rules;
+        const size_t max_entries;
+        std::unordered_map<Key, Moves, KeyHash, KeyEqual> cache;
+    };
+};
@@ -0,0 +1,65 @@
+#include "Nogood.hpp"
+
+#include <algorithm>
+
+#include "Tiling.hpp"
+
+namespace Solver {
+    // a map entry with its node and bucket, roughly
+    constexpr size_t ENTRY_BYTES = 56;
+    constexpr int KEY_ROWS = 6;
+
+    NogoodCache::NogoodCache(size_t max_bytes) : max_per_shard(std::max<size_t>(max_bytes / ENTRY_BYTES / decltype(states)::shard_count, 1)) {}
+
+    bool NogoodCache::make_key(const Board& board, int lines_left, uint32_t pieces, Key& key) {
+        if (any_from_row(board, KEY_ROWS))
+            return false;
+        const auto rows = board_rows(board);
+        key = {.cells = 0, .pieces = pieces, .lines_left = (uint32_t)lines_left};
+        for (int y = 0; y < KEY_ROWS; ++y)
+            key.cells |= uint64_t(rows[y]) << (y * Board::width);
+        return true;
+    }
+
+    bool NogoodCache::dead(const Board& board, int lines_left, uint32_t pieces) {
+        Key key;
+        if (!make_key(board, lines_left, pieces, key))
+            return false;
+
+        lookups.fetch_add(1, std::memory_order_relaxed);
+        auto known = states.with(key, [&](auto& shard) -> std::optional<bool> {
+            auto it = shard.find(key);
+            if (it == shard.end())
+                return std::nullopt;
+            return it->second;
+        });
+        if (known.has_value()) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            // worked out without the lock, two threads on the same state at once only prove it twice
+            known = !can_fill(board, lines_left, pieces);
+            states.with(key, [&](auto& shard) {
+                if (shard.size() >= max_per_shard) {
+                    evictions.fetch_add(shard.size(), std::memory_order_relaxed);
+                    shard.clear();
+                }
+                if (shard.emplace(key, *known).second)
+                    inserts.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        if (*known)
+            pruned.fetch_add(1, std::memory_order_relaxed);
+        return *known;
+    }
+
+    NogoodCache::Stats NogoodCache::stats() const {
+        Stats stats{
+            .lookups = lookups.load(std::memory_order_relaxed),
+            .hits = hits.load(std::memory_order_relaxed),
+            .pruned = pruned.load(std::memory_order_relaxed),
+            .inserts = inserts.load(std::memory_order_relaxed),
+            .evictions = evictions.load(std::memory_order_relaxed)};
+        states.for_each([&](const auto& shard) { stats.entries += shard.size(); });
+        return stats;
+    }
+}
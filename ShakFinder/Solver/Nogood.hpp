@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "ShardedMap.hpp"
+#include "Util.hpp"
+
+namespace Solver {
+    // whether a search state has no pc whatever order the pieces left come in, kept across the queues of a run
+    // a state is the board, the lines left, and how many of each piece are left counting the hold piece,
+    // so a state proven dead for one queue is skipped for every other queue that gets to it with the same pieces
+    // the proof is can_fill, which needs no search, and states it can't rule out are kept too so it runs once per state
+    // safe to share between threads, it is sharded so they rarely wait on each other
+    class NogoodCache {
+    public:
+        // a shard that outgrows its share of max_bytes is emptied and starts over
+        explicit NogoodCache(size_t max_bytes = DEFAULT_BYTES);
+
+        // whether no order of the pieces can fill the field, false for boards too tall to be kept
+        // pieces is a key of piece counts, see add_piece
+        bool dead(const Board& board, int lines_left, uint32_t pieces);
+
+        struct Stats {
+            uint64_t lookups = 0;
+            // lookups answered without running can_fill
+            uint64_t hits = 0;
+            // lookups that came out dead
+            uint64_t pruned = 0;
+            uint64_t inserts = 0;
+            // entries dropped to stay under the memory limit
+            uint64_t evictions = 0;
+            size_t entries = 0;
+        };
+        Stats stats() const;
+
+        static constexpr size_t DEFAULT_BYTES = 64 << 20;
+
+    private:
+        struct Key {
+            // rows 0 to 5, bit y * 10 + x
+            uint64_t cells;
+            uint32_t pieces;
+            uint32_t lines_left;
+            bool operator==(const Key&) const = default;
+        };
+        struct KeyHash {
+            size_t operator()(const Key& key) const noexcept {
+                uint64_t hash = key.cells * 0x9e3779b97f4a7c15ULL;
+                hash ^= (uint64_t(key.pieces) << 8 | key.lines_left) * 0xc2b2ae3d27d4eb4fULL;
+                return hash ^ (hash >> 31);
+            }
+        };
+        static bool make_key(const Board& board, int lines_left, uint32_t pieces, Key& key);
+
+        // whether the state is dead
+        ShardedMap<Key, bool, KeyHash> states;
+        const size_t max_per_shard;
+
+        std::atomic<uint64_t> lookups = 0;
+        std::atomic<uint64_t> hits = 0;
+        std::atomic<uint64_t> pruned = 0;
+        std::atomic<uint64_t> inserts = 0;
+        std::atomic<uint64_t> evictions = 0;
+    };
+};
@@ -0,0 +1,508 @@
+#include "Output.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "Parser.hpp"
+
+namespace Output {
+    // buffered text is handed to the stream once it grows past this
+    constexpr size_t FLUSH_THRESHOLD = 1 << 20;
+
+    std::optional<Format> parse_format(std::string_view name) {
+        if (name == "text")
+            return Format::Text;
+        if (name == "csv")
+            return Format::Csv;
+        if (name == "jsonl" || name == "json")
+            return Format::JsonLines;
+        if (name == "fails")
+            return Format::FailsOnly;
+        return std::nullopt;
+    }
+
+    static void append_queue(std::string& buffer, const Queue& queue) {
+        for (const PieceType& piece : queue)
+            buffer.push_back(Parser::getChar(piece));
+    }
+
+    static Queue read_queue(std::string_view text) {
+        Queue queue;
+        for (char c : text)
+            queue.push_back(Parser::getType(c));
+        return queue;
+    }
+
+    static bool read_index(std::string_view text, size_t& index) {
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), index);
+        return error == std::errc() && end == text.data() + text.size();
+    }
+
+    // the raw text after "key": in a line written by format_result, up to the next , or }
+    static std::optional<std::string_view> json_value(std::string_view line, std::string_view key) {
+        const std::string quoted = "\"" + std::string(key) + "\":";
+        const size_t start = line.find(quoted);
+        if (start == std::string_view::npos)
+            return std::nullopt;
+        std::string_view value = line.substr(start + quoted.size());
+        if (value.starts_with('"'))
+            return value.substr(1, value.find('"', 1) - 1);
+        return value.substr(0, value.find_first_of(",}"));
+    }
+
+    static std::optional<QueueResult> read_json_result(std::string_view line) {
+        auto index = json_value(line, "index");
+        auto queue = json_value(line, "queue");
+        auto solved = json_value(line, "solved");
+        QueueResult result;
+        if (!index.has_value() || !queue.has_value() || !solved.has_value() || !read_index(*index, result.index))
+            return std::nullopt;
+        result.queue = read_queue(*queue);
+        result.solved = *solved == "true";
+        result.timed_out = json_value(line, "timed_out") == "true";
+        if (auto chance = json_value(line, "probability"); chance.has_value())
+            result.probability = std::strtod(std::string(*chance).c_str(), nullptr);
+        return result;
+    }
+
+    std::optional<std::vector<QueueResult>> read_results(std::istream& in, std::optional<size_t>& pattern_total) {
+        std::vector<QueueResult> results;
+        // the csv columns of the file, from its header
+        std::vector<std::string> columns;
+
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line.empty())
+                continue;
+
+            if (line.starts_with('{')) {
+                // the summary line has no queue, it is worked out again from the results
+                if (line.find("\"queue\":") == std::string::npos) {
+                    if (auto total = json_value(line, "pattern_total"); total.has_value()) {
+                        size_t value = 0;
+                        if (!read_index(*total, value))
+                            return std::nullopt;
+                        pattern_total = value;
+                    }
+                    continue;
+                }
+                auto result = read_json_result(line);
+                if (!result.has_value())
+                    return std::nullopt;
+                results.push_back(std::move(*result));
+                continue;
+            }
+
+            std::vector<std::string_view> cells;
+            for (size_t start = 0; start <= line.size();) {
+                const size_t end = std::min(line.find(',', start), line.size());
+                cells.push_back(std::string_view(line).substr(start, end - start));
+                start = end + 1;
+            }
+
+            if (line.starts_with("index,")) {
+                columns.assign(cells.begin(), cells.end());
+                continue;
+            }
+            if (line.starts_with("# pattern_total,")) {
+                size_t value = 0;
+                if (cells.size() != 2 || !read_index(cells[1], value))
+                    return std::nullopt;
+                pattern_total = value;
+                continue;
+            }
+            if (columns.size() != cells.size())
+                return std::nullopt;
+
+            QueueResult result;
+            for (size_t i = 0; i < columns.size(); ++i) {
+                if (columns[i] == "index" && !read_index(cells[i], result.index))
+                    return std::nullopt;
+                if (columns[i] == "queue")
+                    result.queue = read_queue(cells[i]);
+                if (columns[i] == "solved") {
+                    result.solved = cells[i] == "1";
+                    result.timed_out = cells[i] == "timeout";
+                }
+                if (columns[i] == "probability")
+                    result.probability = std::strtod(std::string(cells[i]).c_str(), nullptr);
+            }
+            results.push_back(std::move(result));
+        }
+        return results;
+    }
+
+    Writer::Writer(std::ostream& out, Format format, Columns columns)
+        : out(out), output_format(format), columns(columns), thread([this](std::stop_token stop) { run(stop); }) {
+        buffer.reserve(FLUSH_THRESHOLD * 2);
+    }
+
+    Writer::~Writer() {
+        flush();
+        thread.request_stop();
+        wake.notify_all();
+        thread.join();
+    }
+
+    void Writer::note(std::string text) {
+        std::lock_guard lock(mutex);
+        pending.emplace_back(std::move(text));
+        wake.notify_one();
+    }
+
+    void Writer::result(QueueResult result) {
+        std::lock_guard lock(mutex);
+        pending.emplace_back(std::move(result));
+        wake.notify_one();
+    }
+
+    void Writer::summary(Summary summary) {
+        std::lock_guard lock(mutex);
+        pending.emplace_back(summary);
+        wake.notify_one();
+    }
+
+    void Writer::field(FieldSummary field) {
+        std::lock_guard lock(mutex);
+        pending.emplace_back(std::move(field));
+        wake.notify_one();
+    }
+
+    void Writer::flush() {
+        std::unique_lock lock(mutex);
+        flush_requested = true;
+        wake.notify_one();
+        drained.wait(lock, [this] { return pending.empty() && !busy && !flush_requested; });
+    }
+
+    void Writer::run(std::stop_token stop) {
+        std::vector<Record> batch;
+        while (true) {
+            bool flushing = false;
+            {
+                std::unique_lock lock(mutex);
+                busy = false;
+                drained.notify_all();
+                wake.wait(lock, stop, [this] { return !pending.empty() || flush_requested; });
+                if (pending.empty() && !flush_requested) {
+                    // stopped, whatever is left still goes out
+                    out.write(buffer.data(), buffer.size());
+                    out.flush();
+                    return;
+                }
+                batch.swap(pending);
+                // the flush covers everything handed over before it, which is all in this batch
+                flushing = flush_requested;
+                flush_requested = false;
+                busy = true;
+            }
+
+            for (const Record& record : batch) {
+                format(record);
+                if (buffer.size() >= FLUSH_THRESHOLD) {
+                    out.write(buffer.data(), buffer.size());
+                    buffer.clear();
+                }
+            }
+            batch.clear();
+
+            // most batches are a single line, the stream only sees whole chunks until someone asks for a flush
+            if (flushing) {
+                out.write(buffer.data(), buffer.size());
+                out.flush();
+                buffer.clear();
+            }
+        }
+    }
+
+    void Writer::format(const Record& record) {
+        if (const auto* text = std::get_if<std::string>(&record)) {
+            if (output_format == Format::Text) {
+                buffer += *text;
+                buffer.push_back('\n');
+            }
+        }
+        else if (const auto* result = std::get_if<QueueResult>(&record)) {
+            format_result(*result);
+        }
+        else if (const auto* field = std::get_if<FieldSummary>(&record)) {
+            format_field(*field);
+        }
+        else {
+            format_summary(std::get<Summary>(record));
+        }
+    }
+
+    void Writer::format_result(const QueueResult& result) {
+        switch (output_format) {
+        case Format::Text: {
+            if (!result.solutions.has_value()) {
+                buffer += result.solved ? "solved: " : result.timed_out ? "timed out: " : "unsolvable: ";
+                append_queue(buffer, result.queue);
+                if (result.paths.has_value())
+                    buffer += " (" + std::to_string(*result.paths) + (result.timed_out ? "+" : "") + " paths)";
+                if (result.pcs.has_value())
+                    buffer += " (" + std::to_string(*result.pcs) + (result.timed_out ? "+" : "") + " pcs)";
+                buffer.push_back('\n');
+                break;
+            }
+
+            if (!result.solved) {
+                buffer += result.timed_out ? "we ran out of time on: " : "we could not solve the pc for: ";
+                buffer += std::to_string(result.index + 1) + "\n";
+                append_queue(buffer, result.queue);
+                buffer += "\n\n";
+                break;
+            }
+
+            buffer += result.timed_out ? "solved a thing, but ran out of time looking for more!\n" : "solved a thing!\n";
+            if (result.score.has_value())
+                buffer += "best score: " + std::to_string(*result.score) + "\n";
+            if (result.lines.has_value())
+                buffer += "pc in " + std::to_string(*result.lines) + " lines\n";
+            size_t orderings = 0;
+            for (const auto& pc : *result.solutions) {
+                orderings += pc.orderings;
+                buffer += "the path is " + std::to_string(pc.path.size()) + " long, reached by " + std::to_string(pc.orderings) + " orderings: \n";
+                for (const auto& piece : pc.path) {
+                    buffer += "\t";
+                    buffer.push_back(Parser::getChar(piece.type));
+                    buffer += ": x=" + std::to_string(piece.x) + " y=" + std::to_string(piece.y) + " r=" + std::to_string(piece.r) + "\n";
+                }
+                buffer.push_back('\n');
+            }
+            buffer += "number of unique pcs: " + std::to_string(result.solutions->size()) + " (" + std::to_string(orderings) + " orderings)\n";
+        } break;
+
+        case Format::Csv: {
+            const bool paths = result.solutions.has_value();
+            if (!wrote_header) {
+                buffer += paths ? "index,queue,solved,unique_pcs,orderings" : "index,queue,solved";
+                if (result.paths.has_value())
+                    buffer += ",paths";
+                if (result.pcs.has_value())
+                    buffer += ",pcs";
+                if (result.probability.has_value())
+                    buffer += ",probability";
+                if (columns.score)
+                    buffer += ",score";
+                buffer += columns.lines ? ",lines\n" : "\n";
+                wrote_header = true;
+            }
+            buffer += std::to_string(result.index) + ",";
+            append_queue(buffer, result.queue);
+            // timed out queues are neither 1 nor 0
+            buffer += result.solved ? ",1" : result.timed_out ? ",timeout" : ",0";
+            if (paths) {
+                size_t orderings = 0;
+                for (const auto& pc : *result.solutions)
+                    orderings += pc.orderings;
+                buffer += "," + std::to_string(result.solutions->size()) + "," + std::to_string(orderings);
+            }
+            if (result.paths.has_value())
+                buffer += "," + std::to_string(*result.paths);
+            if (result.pcs.has_value())
+                buffer += "," + std::to_string(*result.pcs);
+            if (result.probability.has_value()) {
+                char chance[64];
+                std::snprintf(chance, sizeof(chance), ",%.9g", *result.probability);
+                buffer += chance;
+            }
+            if (columns.score)
+                buffer += "," + (result.score.has_value() ? std::to_string(*result.score) : std::string());
+            if (columns.lines)
+                buffer += "," + (result.lines.has_value() ? std::to_string(*result.lines) : std::string());
+            buffer.push_back('\n');
+        } break;
+
+        case Format::JsonLines: {
+            buffer += "{\"index\":" + std::to_string(result.index) + ",\"queue\":\"";
+            append_queue(buffer, result.queue);
+            buffer += result.solved ? "\",\"solved\":true" : "\",\"solved\":false";
+            if (result.timed_out)
+                buffer += ",\"timed_out\":true";
+            if (result.paths.has_value())
+                buffer += ",\"paths\":" + std::to_string(*result.paths);
+            if (result.pcs.has_value())
+                buffer += ",\"pcs\":" + std::to_string(*result.pcs);
+            if (result.probability.has_value()) {
+                char chance[64];
+                std::snprintf(chance, sizeof(chance), ",\"probability\":%.9g", *result.probability);
+                buffer += chance;
+            }
+            if (columns.score)
+                buffer += ",\"score\":" + (result.score.has_value() ? std::to_string(*result.score) : std::string("null"));
+            if (columns.lines)
+                buffer += ",\"lines\":" + (result.lines.has_value() ? std::to_string(*result.lines) : std::string("null"));
+            if (result.solutions.has_value()) {
+                buffer += ",\"solutions\":[";
+                for (size_t i = 0; i < result.solutions->size(); ++i) {
+                    const auto& pc = (*result.solutions)[i];
+                    buffer += i == 0 ? "{" : ",{";
+                    buffer += "\"orderings\":" + std::to_string(pc.orderings) + ",\"path\":[";
+                    for (size_t j = 0; j < pc.path.size(); ++j) {
+                        const auto& piece = pc.path[j];
+                        buffer += j == 0 ? "{\"type\":\"" : ",{\"type\":\"";
+                        buffer.push_back(Parser::getChar(piece.type));
+                        buffer += "\",\"x\":" + std::to_string(piece.x) + ",\"y\":" + std::to_string(piece.y) + ",\"r\":" + std::to_string(piece.r) + "}";
+                    }
+                    buffer += "]}";
+                }
+                buffer += "]";
+            }
+            buffer += "}\n";
+        } break;
+
+        case Format::FailsOnly: {
+            // a timed out queue was not proven to fail
+            if (!result.solved && !result.timed_out) {
+                append_queue(buffer, result.queue);
+                buffer.push_back('\n');
+            }
+        } break;
+        }
+    }
+
+    void Writer::format_summary(const Summary& summary) {
+        const double percentage = summary.total == 0 ? 0.0 : (double)summary.solved / summary.total * 100.0;
+
+        switch (output_format) {
+        case Format::Text: {
+            char line[64];
+            std::snprintf(line, sizeof(line), "%g", percentage);
+            buffer += "solved/total: " + std::to_string(summary.solved) + "/" + std::to_string(summary.total) + "\n";
+            buffer += "percentage: " + std::string(line) + "%\n";
+            if (summary.weighted_percentage.has_value()) {
+                std::snprintf(line, sizeof(line), "%g", *summary.weighted_percentage);
+                buffer += "weighted by bag odds: " + std::string(line) + "%\n";
+            }
+            if (summary.timed_out != 0)
+                buffer += "timed out: " + std::to_string(summary.timed_out) + "\n";
+            if (summary.pattern_total.has_value())
+                buffer += "shard of a pattern of " + std::to_string(*summary.pattern_total) + " queues\n";
+            std::snprintf(line, sizeof(line), "%g", summary.seconds);
+            buffer += "Time difference = " + std::string(line) + "[seconds]\n";
+        } break;
+
+        case Format::JsonLines: {
+            char line[64];
+            std::snprintf(line, sizeof(line), "%.6f", percentage);
+            buffer += "{\"solved\":" + std::to_string(summary.solved) + ",\"total\":" + std::to_string(summary.total) + ",\"timed_out\":" + std::to_string(summary.timed_out) + ",\"percentage\":" + line;
+            if (summary.weighted_percentage.has_value()) {
+                std::snprintf(line, sizeof(line), "%.6f", *summary.weighted_percentage);
+                buffer += ",\"weighted_percentage\":" + std::string(line);
+            }
+            if (summary.pattern_total.has_value())
+                buffer += ",\"pattern_total\":" + std::to_string(*summary.pattern_total);
+            std::snprintf(line, sizeof(line), "%.6f", summary.seconds);
+            buffer += ",\"seconds\":" + std::string(line) + "}\n";
+        } break;
+
+        // csv and the fail list stay pure rows so they can be concatenated and piped
+        // except for the size of the pattern at the end of a shard, which merge needs
+        case Format::Csv:
+            if (summary.pattern_total.has_value())
+                buffer += "# pattern_total," + std::to_string(*summary.pattern_total) + "\n";
+            break;
+        case Format::FailsOnly:
+            break;
+        }
+    }
+
+    void Writer::format_field(const FieldSummary& field) {
+        if (field.rank.has_value()) {
+            format_ranked(field);
+            return;
+        }
+        const double percentage = field.total == 0 ? 0.0 : (double)field.solved / field.total * 100.0;
+
+        switch (output_format) {
+        case Format::Text: {
+            char line[64];
+            std::snprintf(line, sizeof(line), "%g", percentage);
+            buffer += "field " + std::to_string(field.index) + " (page " + std::to_string(field.page) + " of " + field.fumen + "): ";
+            buffer += std::to_string(field.solved) + "/" + std::to_string(field.total) + " = " + line + "%";
+            if (field.timed_out != 0)
+                buffer += ", timed out: " + std::to_string(field.timed_out);
+            buffer.push_back('\n');
+        } break;
+
+        case Format::Csv: {
+            char line[64];
+            std::snprintf(line, sizeof(line), "%.6f", percentage);
+            if (!wrote_header) {
+                buffer += "field,fumen,page,solved,total,timed_out,percentage\n";
+                wrote_header = true;
+            }
+            buffer += std::to_string(field.index) + "," + field.fumen + "," + std::to_string(field.page) + ","
+                + std::to_string(field.solved) + "," + std::to_string(field.total) + "," + std::to_string(field.timed_out) + "," + line + "\n";
+        } break;
+
+        case Format::JsonLines: {
+            char line[64];
+            std::snprintf(line, sizeof(line), "%.6f", percentage);
+            buffer += "{\"field\":" + std::to_string(field.index) + ",\"fumen\":\"" + field.fumen + "\",\"page\":" + std::to_string(field.page)
+                + ",\"solved\":" + std::to_string(field.solved) + ",\"total\":" + std::to_string(field.total)
+                + ",\"timed_out\":" + std::to_string(field.timed_out) + ",\"percentage\":" + line + "}\n";
+        } break;
+
+        // there is no single queue that failed for a whole field
+        case Format::FailsOnly:
+            break;
+        }
+    }
+
+    void Writer::format_ranked(const FieldSummary& field) {
+        const double percentage = field.weighted_percentage.value_or(field.total == 0 ? 0.0 : (double)field.solved / field.total * 100.0);
+        const size_t searched = field.searched.value_or(field.total);
+        const double max_percentage = field.max_percentage.value_or(percentage);
+
+        switch (output_format) {
+        case Format::Text: {
+            char line[64];
+            buffer += "#" + std::to_string(*field.rank) + " field " + std::to_string(field.index) + " (page " + std::to_string(field.page) + " of " + field.fumen + "): ";
+            if (searched < field.total) {
+                std::snprintf(line, sizeof(line), "%g", max_percentage);
+                buffer += "at most " + std::string(line) + "%, dropped after " + std::to_string(searched) + "/" + std::to_string(field.total)
+                    + " queues with " + std::to_string(field.solved) + " solved";
+            }
+            else {
+                std::snprintf(line, sizeof(line), "%g", percentage);
+                buffer += std::to_string(field.solved) + "/" + std::to_string(field.total) + " = " + line + "%";
+            }
+            if (field.timed_out != 0)
+                buffer += ", timed out: " + std::to_string(field.timed_out);
+            buffer.push_back('\n');
+        } break;
+
+        case Format::Csv: {
+            char line[96];
+            std::snprintf(line, sizeof(line), "%.6f,%.6f", percentage, max_percentage);
+            if (!wrote_header) {
+                buffer += "rank,field,fumen,page,solved,searched,total,timed_out,percentage,max_percentage\n";
+                wrote_header = true;
+            }
+            buffer += std::to_string(*field.rank) + "," + std::to_string(field.index) + "," + field.fumen + "," + std::to_string(field.page) + ","
+                + std::to_string(field.solved) + "," + std::to_string(searched) + "," + std::to_string(field.total) + ","
+                + std::to_string(field.timed_out) + "," + line + "\n";
+        } break;
+
+        case Format::JsonLines: {
+            char line[96];
+            std::snprintf(line, sizeof(line), "%.6f,\"max_percentage\":%.6f", percentage, max_percentage);
+            buffer += "{\"rank\":" + std::to_string(*field.rank) + ",\"field\":" + std::to_string(field.index) + ",\"fumen\":\"" + field.fumen
+                + "\",\"page\":" + std::to_string(field.page) + ",\"solved\":" + std::to_string(field.solved)
+                + ",\"searched\":" + std::to_string(searched) + ",\"total\":" + std::to_string(field.total)
+                + ",\"timed_out\":" + std::to_string(field.timed_out) + ",\"percentage\":" + line + "}\n";
+        } break;
+
+        case Format::FailsOnly:
+            break;
+        }
+    }
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <condition_variable>
+#include <istream>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "Solver.hpp"
+#include "Util.hpp"
+
+namespace Output {
+    enum class Format {
+        // the human readable output
+        Text,
+        Csv,
+        // one json object per line
+        JsonLines,
+        // only the queues that could not be solved, one per line
+        FailsOnly,
+    };
+
+    // text, csv, jsonl or fails
+    std::optional<Format> parse_format(std::string_view name);
+
+    struct QueueResult {
+        // index of the queue in the expanded pattern
+        size_t index = 0;
+        Queue queue;
+        bool solved = false;
+        // the search hit its deadline, so the queue is neither solved nor proven unsolvable
+        bool timed_out = false;
+        // only set in paths and score mode
+        std::optional<std::vector<Solver::Solution>> solutions;
+        // only set in score mode, the points of the one solution
+        std::optional<int> score;
+        // only set in earliest mode, the lines the one solution clears
+        std::optional<int> lines;
+        // only set in count mode, how many placement orders end in a pc
+        std::optional<uint64_t> paths;
+        // only set in chain mode, how many pcs in a row the queue makes
+        std::optional<int> pcs;
+        // only set for bag patterns, the chance of being dealt this queue
+        std::optional<double> probability;
+    };
+
+    struct Summary {
+        size_t solved = 0;
+        size_t total = 0;
+        size_t timed_out = 0;
+        double seconds = 0;
+        // only set for bag patterns, the percent of dealt queues that pc
+        std::optional<double> weighted_percentage;
+        // only set for --shard runs, how many queues the whole pattern has so merge can tell when shards are missing
+        std::optional<size_t> pattern_total;
+    };
+
+    // the percent of one field in batch and compare mode
+    struct FieldSummary {
+        // index of the field among every page of every fumen given
+        size_t index = 0;
+        std::string fumen;
+        // counting from 1 like fumen editors do
+        size_t page = 1;
+        size_t solved = 0;
+        size_t total = 0;
+        size_t timed_out = 0;
+        // only set for bag patterns, the percent of dealt queues that pc
+        std::optional<double> weighted_percentage;
+
+        // the rest is only set in compare mode
+        // the place of the field, 1 for the best
+        std::optional<size_t> rank;
+        // the queues searched before the field was dropped, total if it never was
+        std::optional<size_t> searched;
+        // the best percent the field could still have reached when it was dropped, weighted for bag patterns
+        std::optional<double> max_percentage;
+    };
+
+    // reads back the queue results of a csv or jsonl run, like the shards of a --shard run
+    // only the index, queue, solved, timed out and probability are kept, nullopt if a line can't be read
+    // pattern_total is set if the run was a shard that got to its summary
+    std::optional<std::vector<QueueResult>> read_results(std::istream& in, std::optional<size_t>& pattern_total);
+
+    // columns of csv and jsonl results that only some queues of a mode have a value for
+    // they are picked by mode, so every row has the same ones and the missing values are left empty
+    struct Columns {
+        // score mode
+        bool score = false;
+        // earliest mode
+        bool lines = false;
+    };
+
+    // formats results and writes them out from its own thread, so the solver never waits on output
+    // everything is written in large chunks instead of flushing every line
+    class Writer {
+    public:
+        Writer(std::ostream& out, Format format, Columns columns = {});
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        // free form progress text, only shown in the text format
+        void note(std::string text);
+        void result(QueueResult result);
+        void summary(Summary summary);
+        void field(FieldSummary field);
+
+        // blocks until everything handed to the writer so far is written out
+        void flush();
+
+    private:
+        using Record = std::variant<std::string, QueueResult, Summary, FieldSummary>;
+
+        void run(std::stop_token stop);
+        void format(const Record& record);
+        void format_result(const QueueResult& result);
+        void format_summary(const Summary& summary);
+        void format_field(const FieldSummary& field);
+        void format_ranked(const FieldSummary& field);
+
+        std::ostream& out;
+        const Format output_format;
+        const Columns columns;
+        bool wrote_header = false;
+        // formatted text that has not been handed to the stream yet
+        std::string buffer;
+
+        std::mutex mutex;
+        std::condition_variable_any wake;
+        std::condition_variable_any drained;
+        std::vector<Record> pending;
+        bool busy = false;
+        // set by flush, the writer hands the buffer to the stream and flushes it once the batch it is in is written
+        bool flush_requested = false;
+
+        // declared last so it is joined before the rest of the writer is destroyed
+        std::jthread thread;
+    };
+};
@@ -1,5 +1,8 @@
 #include "Parser.hpp"
 
+#include <bit>
+#include <charconv>
+
 
 PieceType Parser::getType(char c) {
 	switch (c)
@@ -198,3 +201,142 @@ std::string Parser::preprocess(const std::string input) {
 	}
 	return output;
 }
+
+// bag masks have one bit per piece, in this order so queues come out sorted
+static constexpr std::array<PieceType, 7> BAG_PIECES = { PieceType::I, PieceType::J, PieceType::L, PieceType::O, PieceType::S, PieceType::T, PieceType::Z };
+static constexpr uint8_t FULL_BAG = (1 << BAG_PIECES.size()) - 1;
+
+static uint8_t bag_mask(const std::vector<PieceType>& pieces) {
+	uint8_t mask = 0;
+	for (auto piece : pieces)
+		mask |= 1 << (std::find(BAG_PIECES.begin(), BAG_PIECES.end(), piece) - BAG_PIECES.begin());
+	return mask;
+}
+
+struct BagStep {
+	enum class Kind {
+		// the unseen pieces of the current bag become mask
+		Reset,
+		// draw count pieces that are in mask
+		Draw,
+		// draw every piece left in the current bag
+		DrawRest,
+	};
+	Kind kind;
+	uint8_t mask = FULL_BAG;
+	int count = 1;
+};
+
+// left is the number of draws still to do for steps[step - 1]
+static void expand_bags(const std::vector<BagStep>& steps, size_t step, int left, uint8_t remaining,
+	Queue& queue, double probability, std::vector<Parser::WeightedQueue>& out) {
+	while (left == 0) {
+		if (step == steps.size()) {
+			out.push_back({ queue, probability });
+			return;
+		}
+		const BagStep& next = steps[step++];
+		if (next.kind == BagStep::Kind::Reset)
+			remaining = next.mask;
+		else if (next.kind == BagStep::Kind::DrawRest)
+			left = std::popcount(remaining != 0 ? remaining : FULL_BAG);
+		else
+			left = next.count;
+	}
+
+	// an empty bag means the next piece comes out of a new one
+	if (remaining == 0)
+		remaining = FULL_BAG;
+
+	const double chance = probability / std::popcount(remaining);
+	for (uint8_t options = remaining & steps[step - 1].mask; options != 0; options &= options - 1) {
+		const int piece = std::countr_zero(options);
+		queue.push_back(BAG_PIECES[piece]);
+		expand_bags(steps, step, left - 1, remaining & ~(1 << piece), queue, chance, out);
+		queue.pop_back();
+	}
+}
+
+std::vector<Parser::WeightedQueue> Parser::parse_bags(const std::string& str) {
+	std::vector<BagStep> steps;
+
+	for (size_t i = 0; i < str.size(); ++i) {
+		const char c = str[i];
+
+		if (c == ',' || c == ' ')
+			continue;
+
+		if (c == '|') {
+			steps.push_back({ .kind = BagStep::Kind::Reset, .mask = FULL_BAG });
+			continue;
+		}
+
+		if (c == '*' || c == '[') {
+			uint8_t mask = FULL_BAG;
+			size_t end = i;
+			if (c == '[') {
+				end = str.find(']', i);
+				if (end == std::string::npos) {
+					std::cerr << "Error: Unclosed brackets" << std::endl;
+					return {};
+				}
+
+				auto sub = str.substr(i + 1, end - i - 1);
+				mask = bag_mask(naive_parse(sub));
+				if (sub.starts_with('^'))
+					mask = FULL_BAG & ~mask;
+				if (mask == 0) {
+					std::cerr << "Error: Empty brackets" << std::endl;
+					return {};
+				}
+				steps.push_back({ .kind = BagStep::Kind::Reset, .mask = mask });
+			}
+
+			// the draw that goes with it, one piece unless followed by p# or !
+			BagStep draw{ .kind = BagStep::Kind::Draw, .mask = mask };
+			if (end + 1 < str.size() && str[end + 1] == '!') {
+				draw.kind = BagStep::Kind::DrawRest;
+				end += 1;
+			}
+			else if (end + 1 < str.size() && str[end + 1] == 'p') {
+				const char* first = str.data() + end + 2;
+				auto [last, error] = std::from_chars(first, str.data() + str.size(), draw.count);
+				if (error != std::errc() || draw.count < 0) {
+					std::cerr << "Error: p must be followed by a number" << std::endl;
+					return {};
+				}
+				if (c == '[' && draw.count > std::popcount(mask)) {
+					std::cerr << "Error: p# is greater than the number of pieces in the brackets" << std::endl;
+					return {};
+				}
+				end = last - str.data() - 1;
+			}
+			steps.push_back(draw);
+			i = end;
+			continue;
+		}
+
+		auto type = getType(c);
+		if (type == PieceType::Empty) {
+			std::cerr << "Error: Unknown character in bag pattern: " << c << std::endl;
+			return {};
+		}
+		steps.push_back({ .kind = BagStep::Kind::Draw, .mask = bag_mask({ type }) });
+	}
+
+	std::vector<WeightedQueue> queues;
+	Queue queue;
+	expand_bags(steps, 0, 0, FULL_BAG, queue, 1.0, queues);
+
+	// known pieces rule out some draws, what is left is conditioned on them
+	double total = 0;
+	for (const auto& weighted : queues)
+		total += weighted.probability;
+	for (auto& weighted : queues)
+		weighted.probability /= total;
+
+	if (queues.empty())
+		std::cerr << "Error: No queue can come out of a 7 bag like that" << std::endl;
+
+	return queues;
+}
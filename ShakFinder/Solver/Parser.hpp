@@ -26,4 +26,22 @@ namespace Parser {
 	std::vector< std::vector<PieceType>> parse(const std::string& str);
 
 	std::string preprocess(const std::string input);
+
+	struct WeightedQueue {
+		Queue queue;
+		// the chance of seeing this queue, the chances of every queue of a pattern add up to 1
+		double probability = 0;
+	};
+
+	/*
+	Reads a pattern as draws from a 7 bag randomizer, so only queues a real game can deal come out.
+	The pattern starts on a fresh bag and every piece continues the same bag until it is empty.
+	* draws one piece, *p4 draws four, *! draws whatever is left of the current bag.
+	[SZL] says the pieces not seen yet in the current bag are exactly S, Z and L, and draws one of them.
+	[^TIO] says T, I and O were already seen in the current bag, the same as [SZLJ].
+	Both take p# and ! like * does, so [^TIO]p4,*p3 is the rest of a bag followed by three pieces of the next one.
+	A piece letter is a known piece, queues where it could not have come out of the bag are dropped.
+	| starts a new bag, dropping whatever was left of the old one.
+	*/
+	std::vector<WeightedQueue> parse_bags(const std::string& str);
 };
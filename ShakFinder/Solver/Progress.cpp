@@ -0,0 +1,97 @@
+#include "Progress.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+Progress::Progress(size_t total, std::optional<std::string> path, std::chrono::milliseconds interval)
+    : total(total), path(std::move(path)), interval(interval), begin(std::chrono::steady_clock::now()),
+      thread([this](std::stop_token stop) { run(stop); }) {}
+
+Progress::~Progress() {
+    thread.request_stop();
+    wake.notify_all();
+    thread.join();
+    write(report());
+}
+
+Progress::Slot& Progress::slot() {
+    static std::atomic<size_t> next_thread = 0;
+    thread_local const size_t thread_id = next_thread.fetch_add(1, std::memory_order_relaxed);
+    return slots[thread_id % MAX_SLOTS];
+}
+
+int64_t Progress::elapsed() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void Progress::start(size_t index) {
+    Slot& own = slot();
+    own.index.store(index, std::memory_order_relaxed);
+    own.started.store(elapsed() + 1, std::memory_order_relaxed);
+}
+
+void Progress::finish(bool solved, uint64_t nodes) {
+    Slot& own = slot();
+    own.started.store(0, std::memory_order_relaxed);
+    own.nodes.fetch_add(nodes, std::memory_order_relaxed);
+    if (solved)
+        own.solved.fetch_add(1, std::memory_order_relaxed);
+    own.done.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::string Progress::report() const {
+    uint64_t done = 0, solved = 0, nodes = 0;
+    int64_t slowest_start = 0;
+    uint64_t slowest_index = 0;
+    for (const Slot& slot : slots) {
+        done += slot.done.load(std::memory_order_relaxed);
+        solved += slot.solved.load(std::memory_order_relaxed);
+        nodes += slot.nodes.load(std::memory_order_relaxed);
+        const int64_t started = slot.started.load(std::memory_order_relaxed);
+        if (started != 0 && (slowest_start == 0 || started < slowest_start)) {
+            slowest_start = started;
+            slowest_index = slot.index.load(std::memory_order_relaxed);
+        }
+    }
+
+    const int64_t now = elapsed();
+    const double seconds = now / 1e9;
+    const double rate = seconds > 0 ? done / seconds : 0;
+    const double eta = rate > 0 && total > done ? (total - done) / rate : 0;
+
+    char line[256];
+    int length = std::snprintf(line, sizeof(line), "progress: %llu/%zu (%.1f%%) %.1f queues/s %.3g nodes/s eta %.0fs solved %.2f%%",
+        (unsigned long long)done, total, total == 0 ? 100.0 : 100.0 * done / total, rate, seconds > 0 ? nodes / seconds : 0.0,
+        eta, done == 0 ? 0.0 : 100.0 * solved / done);
+    if (slowest_start != 0 && length > 0 && (size_t)length < sizeof(line))
+        std::snprintf(line + length, sizeof(line) - length, " slowest: queue %llu for %.1fs",
+            (unsigned long long)slowest_index, (now - slowest_start + 1) / 1e9);
+    return line;
+}
+
+void Progress::write(const std::string& text) const {
+    if (!path.has_value()) {
+        std::cerr << text << std::endl;
+        return;
+    }
+    // renamed into place so whatever is watching the file never sees half a report
+    const std::string temporary = *path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        file << text << "\n";
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, *path, error);
+}
+
+void Progress::run(std::stop_token stop) {
+    std::unique_lock lock(mutex);
+    while (true) {
+        wake.wait_for(lock, stop, interval, [] { return false; });
+        if (stop.stop_requested())
+            return;
+        write(report());
+    }
+}
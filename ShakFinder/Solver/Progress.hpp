@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+// reports how a run is going every so often, on stderr or by rewriting a stats file
+// every thread counts into its own cache line with relaxed atomics, the reporter only ever reads them,
+// so the solver threads never wait on it or on each other
+class Progress {
+public:
+    Progress(size_t total, std::optional<std::string> path, std::chrono::milliseconds interval = std::chrono::seconds(1));
+    // stops the reporter and writes one last report
+    ~Progress();
+
+    Progress(const Progress&) = delete;
+    Progress& operator=(const Progress&) = delete;
+
+    // the calling thread starts on the queue at index
+    void start(size_t index);
+    // the calling thread is done with its queue
+    void finish(bool solved, uint64_t nodes);
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> done = 0;
+        std::atomic<uint64_t> solved = 0;
+        std::atomic<uint64_t> nodes = 0;
+        // nanoseconds since the run began that the current queue was started at, plus one so 0 means idle
+        std::atomic<int64_t> started = 0;
+        std::atomic<uint64_t> index = 0;
+    };
+    // threads past this many share slots, which only blurs which queue is the slowest
+    static constexpr size_t MAX_SLOTS = 64;
+
+    Slot& slot();
+    int64_t elapsed() const;
+    std::string report() const;
+    void write(const std::string& text) const;
+    void run(std::stop_token stop);
+
+    std::array<Slot, MAX_SLOTS> slots;
+    const size_t total;
+    const std::optional<std::string> path;
+    const std::chrono::milliseconds interval;
+    const std::chrono::steady_clock::time_point begin;
+
+    std::mutex mutex;
+    std::condition_variable_any wake;
+    // declared last so it is joined before the rest is destroyed
+    std::jthread thread;
+};
@@ -0,0 +1,262 @@
+#include "QueueFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+
+#include "Parser.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr char MAGIC[8] = {'S', 'F', 'Q', 'U', 'E', 'U', 'E', '1'};
+    // the magic, the queue length in one byte and zeroes
+    constexpr size_t HEADER_SIZE = 16;
+
+    // the same piece codes as the result cache
+    constexpr std::string_view PIECE_ORDER = "SZIOLJT";
+
+    // text chunks are cut at the first line break after every this many bytes
+    constexpr size_t TEXT_CHUNK_BYTES = 64 << 10;
+    constexpr size_t PACKED_CHUNK_QUEUES = 8192;
+
+    size_t record_size(size_t queue_length) {
+        return (queue_length * 3 + 7) / 8;
+    }
+
+    // the line without its line break and trailing blanks, empty for lines that don't hold a queue
+    std::string_view queue_text(std::string_view line) {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+            line.remove_suffix(1);
+        if (line.starts_with('#'))
+            return {};
+        return line;
+    }
+
+    // calls f(line, offset) for every line that starts in [begin, end), stopping once f returns false
+    template <typename F>
+    bool for_each_line(const char* text, size_t begin, size_t end, F&& f) {
+        while (begin < end) {
+            const char* newline = static_cast<const char*>(std::memchr(text + begin, '\n', end - begin));
+            const size_t line_end = newline != nullptr ? size_t(newline - text) : end;
+            if (!f(std::string_view(text + begin, line_end - begin), begin))
+                return false;
+            begin = line_end + 1;
+        }
+        return true;
+    }
+}
+
+QueueFile::QueueFile(const std::string& path) {
+#ifndef _WIN32
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error_message = "could not open queue file " + path;
+        return;
+    }
+    struct stat info{};
+    if (::fstat(fd, &info) != 0) {
+        ::close(fd);
+        error_message = "could not open queue file " + path;
+        return;
+    }
+
+    // an empty file is a text file without queues, there is nothing to map
+    mapped_size = size_t(info.st_size);
+    if (mapped_size != 0) {
+        void* memory = ::mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (memory == MAP_FAILED) {
+            ::close(fd);
+            mapped_size = 0;
+            error_message = "could not map queue file " + path;
+            return;
+        }
+        // chunks are mostly read front to back, so the kernel can read ahead
+        ::madvise(memory, mapped_size, MADV_SEQUENTIAL);
+        mapped = static_cast<const char*>(memory);
+    }
+    // the mapping keeps the file open
+    ::close(fd);
+
+    if (mapped_size >= HEADER_SIZE && std::memcmp(mapped, MAGIC, sizeof(MAGIC)) == 0) {
+        queue_length = (unsigned char)mapped[sizeof(MAGIC)];
+        if (queue_length == 0 || (mapped_size - HEADER_SIZE) % record_size(queue_length) != 0)
+            error_message = "packed queue file " + path + " is cut off or broken";
+    }
+#else
+    error_message = "queue files are not supported on windows yet";
+#endif
+}
+
+QueueFile::~QueueFile() {
+#ifndef _WIN32
+    if (mapped != nullptr)
+        ::munmap(const_cast<char*>(mapped), mapped_size);
+#endif
+}
+
+size_t QueueFile::chunks() const {
+    if (!is_open())
+        return 0;
+    if (packed()) {
+        const size_t queues = (mapped_size - HEADER_SIZE) / record_size(queue_length);
+        return (queues + PACKED_CHUNK_QUEUES - 1) / PACKED_CHUNK_QUEUES;
+    }
+    return (mapped_size + TEXT_CHUNK_BYTES - 1) / TEXT_CHUNK_BYTES;
+}
+
+std::pair<size_t, size_t> QueueFile::text_range(size_t chunk) const {
+    // a line belongs to the chunk it starts in, so both ends move up to the next line start
+    auto line_start = [this](size_t offset) {
+        if (offset == 0 || offset >= mapped_size)
+            return std::min(offset, mapped_size);
+        if (mapped[offset - 1] == '\n')
+            return offset;
+        const char* newline = static_cast<const char*>(std::memchr(mapped + offset, '\n', mapped_size - offset));
+        return newline != nullptr ? size_t(newline - mapped) + 1 : mapped_size;
+    };
+    return {line_start(chunk * TEXT_CHUNK_BYTES), line_start((chunk + 1) * TEXT_CHUNK_BYTES)};
+}
+
+size_t QueueFile::count(size_t chunk) const {
+    if (packed()) {
+        const size_t queues = (mapped_size - HEADER_SIZE) / record_size(queue_length);
+        return std::min(PACKED_CHUNK_QUEUES, queues - chunk * PACKED_CHUNK_QUEUES);
+    }
+
+    size_t queues = 0;
+    const auto [begin, end] = text_range(chunk);
+    for_each_line(mapped, begin, end, [&](std::string_view line, size_t) {
+        if (!queue_text(line).empty())
+            queues++;
+        return true;
+    });
+    return queues;
+}
+
+size_t QueueFile::count() const {
+    size_t queues = 0;
+    for (size_t chunk = 0; chunk < chunks(); ++chunk)
+        queues += count(chunk);
+    return queues;
+}
+
+bool QueueFile::for_each_queue(size_t chunk, const std::function<void(const Queue&)>& f, std::string& error) const {
+    Queue queue;
+    if (packed()) {
+        const size_t size = record_size(queue_length);
+        const size_t first = chunk * PACKED_CHUNK_QUEUES;
+        const unsigned char* records = reinterpret_cast<const unsigned char*>(mapped + HEADER_SIZE);
+        for (size_t i = first; i < first + count(chunk); ++i) {
+            const unsigned char* record = records + i * size;
+            queue.clear();
+            for (size_t piece = 0; piece < queue_length; ++piece) {
+                const size_t bit = piece * 3;
+                // a piece can straddle two bytes, the byte after the last one of a record is never needed
+                unsigned code = record[bit / 8] >> (bit % 8);
+                if (bit % 8 > 5)
+                    code |= unsigned(record[bit / 8 + 1]) << (8 - bit % 8);
+                code &= 7;
+                if (code >= PIECE_ORDER.size()) {
+                    error = "queue " + std::to_string(i) + " of the packed queue file has a piece that doesn't exist";
+                    return false;
+                }
+                queue.push_back(PieceType(PIECE_ORDER[code]));
+            }
+            f(queue);
+        }
+        return true;
+    }
+
+    const auto [begin, end] = text_range(chunk);
+    return for_each_line(mapped, begin, end, [&](std::string_view line, size_t offset) {
+        const std::string_view text = queue_text(line);
+        if (text.empty())
+            return true;
+        queue.clear();
+        for (char c : text) {
+            const PieceType piece = Parser::getType(c);
+            if (piece == PieceType::Empty) {
+                error = "the line at byte " + std::to_string(offset) + " of the queue file is not a queue: " + std::string(text);
+                return false;
+            }
+            queue.push_back(piece);
+        }
+        f(queue);
+        return true;
+    });
+}
+
+bool QueueFile::pack(const std::string& text_path, const std::string& packed_path, std::string& error) {
+    QueueFile text(text_path);
+    if (!text.is_open()) {
+        error = text.error();
+        return false;
+    }
+    if (text.packed()) {
+        error = text_path + " is packed already";
+        return false;
+    }
+
+    std::ofstream out(packed_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        error = "could not write " + packed_path;
+        return false;
+    }
+
+    size_t length = 0;
+    // the callback can't stop the chunk it is in, so a queue that can't be packed only stops the next one
+    bool fits = true;
+    std::string record;
+    for (size_t chunk = 0; chunk < text.chunks(); ++chunk) {
+        bool valid = text.for_each_queue(chunk, [&](const Queue& queue) {
+            if (length == 0) {
+                length = queue.size();
+                fits = length <= 255;
+                if (!fits)
+                    return;
+                char header[HEADER_SIZE]{};
+                std::memcpy(header, MAGIC, sizeof(MAGIC));
+                header[sizeof(MAGIC)] = char(length);
+                out.write(header, sizeof(header));
+            }
+            fits = fits && queue.size() == length;
+            if (!fits)
+                return;
+
+            record.assign(record_size(length), '\0');
+            for (size_t piece = 0; piece < length; ++piece) {
+                const unsigned code = unsigned(PIECE_ORDER.find(char(queue[piece])));
+                const size_t bit = piece * 3;
+                record[bit / 8] |= char(code << (bit % 8));
+                if (bit % 8 > 5)
+                    record[bit / 8 + 1] |= char(code >> (8 - bit % 8));
+            }
+            out.write(record.data(), record.size());
+        }, error);
+        if (!valid)
+            return false;
+        if (!fits) {
+            error = length > 255 ? "queues of more than 255 pieces can't be packed"
+                : "every queue has to be " + std::to_string(length) + " pieces long to be packed";
+            return false;
+        }
+    }
+    if (length == 0) {
+        error = text_path + " has no queues";
+        return false;
+    }
+
+    out.flush();
+    if (!out) {
+        error = "could not write " + packed_path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include "Util.hpp"
+
+// queues that come from somewhere else, like replays, read straight out of a memory mapped file
+// the file is split into chunks that can be read on different threads at once, and a chunk is only looked at
+// when it is read, so a run can start on the first queues of a huge file without reading the rest of it first
+// text files have one queue per line, like TILJSZO, empty lines and lines starting with # are skipped
+// packed files start with the header pack writes, then every queue as 3 bits per piece in a fixed size record
+class QueueFile {
+public:
+    // opens and maps the file at path, check is_open and error
+    explicit QueueFile(const std::string& path);
+    ~QueueFile();
+
+    QueueFile(const QueueFile&) = delete;
+    QueueFile& operator=(const QueueFile&) = delete;
+
+    bool is_open() const { return error_message.empty(); }
+    // why the file could not be opened
+    const std::string& error() const { return error_message; }
+
+    bool packed() const { return queue_length != 0; }
+
+    size_t chunks() const;
+
+    // how many queues the chunk has, text chunks are scanned for them
+    size_t count(size_t chunk) const;
+    // how many queues the whole file has, for text files that scans all of it
+    size_t count() const;
+
+    // calls f with every queue of the chunk in the order of the file, the queue is only valid during the call
+    // returns false with an error at the first line that is not a queue, the queues before it were already given to f
+    bool for_each_queue(size_t chunk, const std::function<void(const Queue&)>& f, std::string& error) const;
+
+    // writes the queues of a text queue file as a packed one, they all have to be the same length
+    static bool pack(const std::string& text_path, const std::string& packed_path, std::string& error);
+
+private:
+    // the part of the file text chunk holds, starting at the first line that starts in it
+    std::pair<size_t, size_t> text_range(size_t chunk) const;
+
+    const char* mapped = nullptr;
+    size_t mapped_size = 0;
+    // the pieces in every queue of a packed file, 0 for text files
+    size_t queue_length = 0;
+    std::string error_message;
+};
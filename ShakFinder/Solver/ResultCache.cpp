@@ -0,0 +1,336 @@
+#include "ResultCache.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr char MAGIC[8] = {'S', 'F', 'C', 'A', 'C', 'H', 'E', '1'};
+
+    // longest queue that still packs into 63 bits, 3 bits per piece
+    constexpr size_t MAX_QUEUE = 21;
+    // a 4 line pc takes at most 10 pieces
+    constexpr size_t MAX_WITNESS = 12;
+    constexpr int MAX_HEIGHT = 6;
+
+    constexpr std::string_view PIECE_ORDER = "SZIOLJT";
+}
+
+struct ResultCache::Record {
+    uint64_t hash;
+    // the first height rows of the board, bit y * 10 + x
+    uint64_t board;
+    // 3 bits per piece, first piece in the lowest bits
+    uint64_t queue;
+    uint8_t queue_length;
+    uint8_t height;
+    uint8_t rules;
+    uint8_t solvable;
+    uint8_t witness_length;
+    uint8_t reserved[3];
+    // per piece type(3) x(4) y(3) r(2)
+    uint16_t witness[MAX_WITNESS];
+    uint32_t checksum;
+    uint32_t reserved2;
+};
+
+static uint32_t checksum(const std::byte* bytes, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= uint32_t(bytes[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// packs the key of a record, false if the field or queue don't fit in one
+static bool pack_key(const Board& board, const Queue& queue, int height, uint8_t rules,
+                     uint64_t& board_bits, uint64_t& queue_bits, uint64_t& hash) {
+    if (height <= 0 || height > MAX_HEIGHT || queue.size() > MAX_QUEUE)
+        return false;
+
+    const auto rows = board_rows(board);
+    board_bits = 0;
+    for (int y = 0; y < (int)Board::height; ++y) {
+        if (y >= height) {
+            // anything above the pc height would make the field a different problem
+            if (rows[y] != 0)
+                return false;
+            continue;
+        }
+        board_bits |= uint64_t(rows[y]) << (y * Board::width);
+    }
+
+    queue_bits = 0;
+    for (size_t i = 0; i < queue.size(); ++i) {
+        auto type = PIECE_ORDER.find(char(queue[i]));
+        if (type == std::string_view::npos)
+            return false;
+        queue_bits |= uint64_t(type) << (i * 3);
+    }
+
+    hash = mix(board_bits ^ mix(queue_bits ^ mix(uint64_t(queue.size()) << 16 | uint64_t(height) << 8 | rules)));
+    return true;
+}
+
+ResultCache::ResultCache(std::string path) : path(std::move(path)) {
+#ifndef _WIN32
+    fd = ::open(this->path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0)
+        return;
+
+    // whoever creates the file writes the header, the lock keeps two creators from both writing one
+    ::flock(fd, LOCK_EX);
+    struct stat info{};
+    if (::fstat(fd, &info) == 0 && info.st_size == 0) {
+        std::byte header[sizeof(Record)]{};
+        std::memcpy(header, MAGIC, sizeof(MAGIC));
+        if (::write(fd, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+            ::flock(fd, LOCK_UN);
+            ::close(fd);
+            fd = -1;
+            return;
+        }
+    }
+    ::flock(fd, LOCK_UN);
+
+    map_file();
+#endif
+}
+
+ResultCache::~ResultCache() {
+#ifndef _WIN32
+    unmap_file();
+    if (fd >= 0)
+        ::close(fd);
+#endif
+}
+
+void ResultCache::map_file() {
+#ifndef _WIN32
+    index.clear();
+    appended.clear();
+
+    struct stat info{};
+    if (::fstat(fd, &info) != 0)
+        return;
+
+    // a record that is still being appended by another process is cut off here
+    mapped_size = size_t(info.st_size) / sizeof(Record) * sizeof(Record);
+    if (mapped_size < sizeof(Record))
+        return;
+
+    void* memory = ::mmap(nullptr, mapped_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (memory == MAP_FAILED) {
+        mapped_size = 0;
+        return;
+    }
+    mapped = static_cast<const std::byte*>(memory);
+
+    if (std::memcmp(mapped, MAGIC, sizeof(MAGIC)) != 0) {
+        // not a cache file, don't touch it
+        unmap_file();
+        ::close(fd);
+        fd = -1;
+        return;
+    }
+
+    for (size_t offset = sizeof(Record); offset < mapped_size; offset += sizeof(Record)) {
+        Record record;
+        std::memcpy(&record, mapped + offset, sizeof(Record));
+        if (record.checksum != checksum(mapped + offset, offsetof(Record, checksum)))
+            continue;
+        // later records win
+        index[record.hash] = offset;
+    }
+#endif
+}
+
+void ResultCache::unmap_file() {
+#ifndef _WIN32
+    if (mapped != nullptr)
+        ::munmap(const_cast<std::byte*>(mapped), mapped_size);
+    mapped = nullptr;
+    mapped_size = 0;
+#endif
+}
+
+bool ResultCache::reopen_if_replaced() {
+#ifndef _WIN32
+    // compaction renames a new file over the old one, appending to the old one after that would lose the record
+    struct stat on_disk{};
+    struct stat opened{};
+    if (::stat(path.c_str(), &on_disk) != 0 || ::fstat(fd, &opened) != 0)
+        return false;
+    if (on_disk.st_ino == opened.st_ino && on_disk.st_dev == opened.st_dev)
+        return false;
+
+    int new_fd = ::open(path.c_str(), O_RDWR | O_APPEND);
+    if (new_fd < 0)
+        return false;
+    unmap_file();
+    ::close(fd);
+    fd = new_fd;
+    map_file();
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::optional<ResultCache::Entry> ResultCache::find(const Board& board, const Queue& queue, int height, uint8_t rules) const {
+    if (!is_open())
+        return std::nullopt;
+
+    uint64_t board_bits, queue_bits, hash;
+    if (!pack_key(board, queue, height, rules, board_bits, queue_bits, hash))
+        return std::nullopt;
+
+    Record record;
+    if (auto it = appended.find(hash); it != appended.end())
+        std::memcpy(&record, it->second.data(), sizeof(Record));
+    else if (auto it = index.find(hash); it != index.end())
+        std::memcpy(&record, mapped + it->second, sizeof(Record));
+    else
+        return std::nullopt;
+
+    // the hash only picks the record, the key itself has to match
+    if (record.board != board_bits || record.queue != queue_bits || record.queue_length != queue.size() ||
+        record.height != height || record.rules != rules)
+        return std::nullopt;
+
+    Entry entry{.solvable = record.solvable != 0};
+    if (record.witness_length != 0) {
+        std::vector<FullPiece> witness;
+        for (size_t i = 0; i < record.witness_length && i < MAX_WITNESS; ++i) {
+            const uint16_t packed = record.witness[i];
+            witness.push_back({
+                .type = PieceType(PIECE_ORDER[(packed >> 9) & 7]),
+                .x = int8_t((packed >> 5) & 15),
+                .y = int8_t((packed >> 2) & 7),
+                .r = int8_t(packed & 3)});
+        }
+        entry.witness = std::move(witness);
+    }
+    return entry;
+}
+
+void ResultCache::insert(const Board& board, const Queue& queue, int height, uint8_t rules, const Entry& entry) {
+#ifndef _WIN32
+    if (!is_open())
+        return;
+
+    Record record{};
+    if (!pack_key(board, queue, height, rules, record.board, record.queue, record.hash))
+        return;
+    record.queue_length = uint8_t(queue.size());
+    record.height = uint8_t(height);
+    record.rules = rules;
+    record.solvable = entry.solvable ? 1 : 0;
+
+    if (entry.witness.has_value() && entry.witness->size() <= MAX_WITNESS) {
+        record.witness_length = uint8_t(entry.witness->size());
+        for (size_t i = 0; i < entry.witness->size(); ++i) {
+            const FullPiece& piece = (*entry.witness)[i];
+            const auto type = PIECE_ORDER.find(char(piece.type));
+            if (type == std::string_view::npos || piece.x < 0 || piece.x > 15 || piece.y < 0 || piece.y > 7) {
+                record.witness_length = 0;
+                break;
+            }
+            record.witness[i] = uint16_t(type << 9 | piece.x << 5 | piece.y << 2 | (piece.r & 3));
+        }
+    }
+
+    record.checksum = checksum(reinterpret_cast<const std::byte*>(&record), offsetof(Record, checksum));
+
+    // shared lock so compaction can't swap the file out between the check and the append
+    // closing the old file drops its lock, so after a reopen the new file is locked and checked again
+    do {
+        ::flock(fd, LOCK_SH);
+    } while (reopen_if_replaced() && fd >= 0);
+    if (fd < 0)
+        return;
+    // O_APPEND makes the whole record land at the end in one piece, even with other writers
+    bool written = ::write(fd, &record, sizeof(record)) == (ssize_t)sizeof(record);
+    ::flock(fd, LOCK_UN);
+
+    if (written) {
+        std::vector<std::byte> bytes(sizeof(Record));
+        std::memcpy(bytes.data(), &record, sizeof(Record));
+        appended[record.hash] = std::move(bytes);
+    }
+#endif
+}
+
+bool ResultCache::compact(const std::string& path) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDWR);
+    if (fd < 0)
+        return false;
+
+    // writers hold a shared lock while appending, so nothing is appended to the old file after this
+    ::flock(fd, LOCK_EX);
+
+    bool ok = false;
+    struct stat info{};
+    if (::fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(Record)) {
+        const size_t size = size_t(info.st_size) / sizeof(Record) * sizeof(Record);
+        std::vector<std::byte> bytes(size);
+        if (::pread(fd, bytes.data(), size, 0) == (ssize_t)size && std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) == 0) {
+            // newest record per key, in the order the keys first showed up
+            std::unordered_map<uint64_t, size_t> newest;
+            std::vector<uint64_t> order;
+            for (size_t offset = sizeof(Record); offset < size; offset += sizeof(Record)) {
+                Record record;
+                std::memcpy(&record, bytes.data() + offset, sizeof(Record));
+                if (record.checksum != checksum(bytes.data() + offset, offsetof(Record, checksum)))
+                    continue;
+                auto [it, inserted] = newest.try_emplace(record.hash, offset);
+                if (inserted)
+                    order.push_back(record.hash);
+                else
+                    it->second = offset;
+            }
+
+            std::vector<std::byte> compacted(bytes.begin(), bytes.begin() + sizeof(Record));
+            for (uint64_t hash : order) {
+                const size_t offset = newest[hash];
+                compacted.insert(compacted.end(), bytes.begin() + offset, bytes.begin() + offset + sizeof(Record));
+            }
+
+            const std::string temp = path + ".compact";
+            int out = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (out >= 0) {
+                ok = ::write(out, compacted.data(), compacted.size()) == (ssize_t)compacted.size() && ::fsync(out) == 0;
+                ::close(out);
+                ok = ok && ::rename(temp.c_str(), path.c_str()) == 0;
+                if (!ok)
+                    ::unlink(temp.c_str());
+            }
+        }
+    }
+
+    ::flock(fd, LOCK_UN);
+    ::close(fd);
+    return ok;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Util.hpp"
+
+// append only file of solved queues, so reruns of the same field and pattern don't search again
+// the file is memory mapped for reading and only ever grows by whole records appended with O_APPEND,
+// so any number of processes can read it and add to it at the same time
+// records appended by other processes after a cache was opened are only seen after reopening it
+class ResultCache {
+public:
+    struct Entry {
+        bool solvable = false;
+        // one pc path, if the search that produced the entry kept one
+        std::optional<std::vector<FullPiece>> witness;
+    };
+
+    // opens the cache at path, creating it if it does not exist yet
+    explicit ResultCache(std::string path);
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    bool is_open() const { return fd >= 0; }
+
+    // rules identifies everything besides the field, queue and height that changes the answer,
+    // like the rotation system and whether hold is allowed
+    std::optional<Entry> find(const Board& board, const Queue& queue, int height, uint8_t rules) const;
+
+    // does nothing for fields or queues that don't fit in a record
+    void insert(const Board& board, const Queue& queue, int height, uint8_t rules, const Entry& entry);
+
+    size_t size() const { return index.size(); }
+
+    // rewrites the file with only the newest record of every key and atomically swaps it in
+    // readers that have the old file open keep reading it until they reopen
+    static bool compact(const std::string& path);
+
+private:
+    struct Record;
+
+    void map_file();
+    void unmap_file();
+    // whether fd was swapped for the file now at path, the new one is not locked
+    bool reopen_if_replaced();
+
+    std::string path;
+    int fd = -1;
+    const std::byte* mapped = nullptr;
+    size_t mapped_size = 0;
+    // key hash to the offset of the newest record with that key
+    std::unordered_map<uint64_t, size_t> index;
+    // records this process appended since the file was mapped
+    std::unordered_map<uint64_t, std::vector<std::byte>> appended;
+};
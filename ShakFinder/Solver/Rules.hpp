@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// the game rules a search runs under, the search and movegen are instantiated once per ruleset
+// so anything a ruleset turns off is compiled out rather than checked at every node
+namespace Rules {
+    enum class Rotation : uint8_t {
+        // guideline srs, what jstris uses
+        SRS,
+        // tetr.io's srs+, srs with symmetric I kicks plus 180 spins with tetr.io's 180 kicks
+        SRS180,
+    };
+
+    template <Rotation R, bool Hold>
+    struct Ruleset {
+        static constexpr Rotation rotation = R;
+        static constexpr bool hold = Hold;
+    };
+
+    using Srs = Ruleset<Rotation::SRS, true>;
+    using Srs180 = Ruleset<Rotation::SRS180, true>;
+    using SrsNoHold = Ruleset<Rotation::SRS, false>;
+    using Srs180NoHold = Ruleset<Rotation::SRS180, false>;
+
+    // the rulesets that can be picked at runtime, the value is also what result caches store
+    enum class Id : uint8_t {
+        Srs = 0,
+        Srs180 = 1,
+        SrsNoHold = 2,
+        Srs180NoHold = 3,
+    };
+
+    // srs, srs180, srs-nohold or srs180-nohold
+    inline std::optional<Id> parse(std::string_view name) {
+        if (name == "srs")
+            return Id::Srs;
+        if (name == "srs180")
+            return Id::Srs180;
+        if (name == "srs-nohold")
+            return Id::SrsNoHold;
+        if (name == "srs180-nohold")
+            return Id::Srs180NoHold;
+        return std::nullopt;
+    }
+
+    // the id that stands for the ruleset R, the other way around from visit
+    template <typename R>
+    constexpr Id id() {
+        if constexpr (R::rotation == Rotation::SRS180)
+            return R::hold ? Id::Srs180 : Id::Srs180NoHold;
+        else
+            return R::hold ? Id::Srs : Id::SrsNoHold;
+    }
+
+    // calls f.template operator()<Ruleset>() with the ruleset id stands for
+    template <typename F>
+    decltype(auto) visit(Id id, F&& f) {
+        switch (id) {
+        case Id::Srs180:
+            return f.template operator()<Srs180>();
+        case Id::SrsNoHold:
+            return f.template operator()<SrsNoHold>();
+        case Id::Srs180NoHold:
+            return f.template operator()<Srs180NoHold>();
+        default:
+            return f.template operator()<Srs>();
+        }
+    }
+};
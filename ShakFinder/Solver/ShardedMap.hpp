@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Solver {
+    // a hash map split into shards with a lock each, so threads that share it rarely wait on each other
+    // a V of void makes it a set
+    // the maps are only reached through calls that hold the shard's lock while they run
+    template <typename K, typename V, typename Hash = std::hash<K>, typename Equal = std::equal_to<K>, size_t Shards = 16>
+    class ShardedMap {
+    public:
+        using Map = std::conditional_t<std::is_void_v<V>, std::unordered_set<K, Hash, Equal>, std::unordered_map<K, V, Hash, Equal>>;
+        static constexpr size_t shard_count = Shards;
+
+        // calls f with the map of the shard key belongs in, and returns what f does
+        template <typename F>
+        decltype(auto) with(const K& key, F&& f) {
+            Shard& shard = shards[index(key)];
+            std::lock_guard lock(shard.mutex);
+            return f(shard.map);
+        }
+
+        // calls f with the map of every shard in turn
+        template <typename F>
+        void for_each(F&& f) {
+            for (Shard& shard : shards) {
+                std::lock_guard lock(shard.mutex);
+                f(shard.map);
+            }
+        }
+        template <typename F>
+        void for_each(F&& f) const {
+            for (const Shard& shard : shards) {
+                std::lock_guard lock(shard.mutex);
+                f(shard.map);
+            }
+        }
+
+    private:
+        struct Shard {
+            mutable std::mutex mutex;
+            Map map;
+        };
+
+        static size_t index(const K& key) {
+            return Hash{}(key) % Shards;
+        }
+
+        std::array<Shard, Shards> shards;
+    };
+};
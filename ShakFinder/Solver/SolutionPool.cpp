@@ -0,0 +1,52 @@
+#include "SolutionPool.hpp"
+
+#include <algorithm>
+
+namespace Solver {
+    SolutionPool::SolutionPool(const Board& board, Rules::Id rules, size_t capacity) : order(board, rules), capacity(capacity) {
+        can_hold = Rules::visit(rules, []<typename R>() { return R::hold; });
+        fits = !any_from_row(board, PC_HEIGHT);
+    }
+
+    std::optional<std::vector<FullPiece>> SolutionPool::find(const Queue& queue, uint64_t& nodes) {
+        lookup_count++;
+
+        std::vector<FullPiece> path;
+        for (auto it = solutions.begin(); it != solutions.end(); ++it) {
+            // cheap check on the pieces before looking for an order
+            const auto keys = queue_keys(queue, it->tiles.size(), can_hold);
+            if (!std::binary_search(keys.begin(), keys.end(), it->pieces))
+                continue;
+            if (!order.find(it->tiles, queue, path, nodes))
+                continue;
+
+            hit_count++;
+            std::rotate(solutions.begin(), it, it + 1);
+            return path;
+        }
+        return std::nullopt;
+    }
+
+    void SolutionPool::add(const std::vector<FullPiece>& witness) {
+        if (!applicable())
+            return;
+        auto tiles = order.tiles(witness);
+        if (!tiles.has_value())
+            return;
+
+        // the same pc reached by another order is the same solution
+        auto by_cells = [](const Tile& a, const Tile& b) { return a.cells < b.cells; };
+        std::sort(tiles->begin(), tiles->end(), by_cells);
+        const bool known = std::any_of(solutions.begin(), solutions.end(), [&](const Solution& solution) {
+            return std::equal(solution.tiles.begin(), solution.tiles.end(), tiles->begin(), tiles->end(),
+                [](const Tile& a, const Tile& b) { return a.type == b.type && a.cells == b.cells; });
+        });
+        if (known)
+            return;
+
+        if (solutions.size() == capacity)
+            solutions.pop_back();
+        const uint32_t pieces = pieces_key(*tiles);
+        solutions.push_front({.tiles = std::move(*tiles), .pieces = pieces});
+    }
+}
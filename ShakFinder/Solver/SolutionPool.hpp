@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+#include "Rules.hpp"
+#include "Solver.hpp"
+#include "Tiling.hpp"
+
+namespace Solver {
+    // the last few pcs found on one field, queues next to each other in a pattern are often solved by the same one
+    // a queue is checked against the pool before it gets a full search, most recently used solutions first
+    // a pool is for one thread
+    class SolutionPool {
+    public:
+        SolutionPool(const Board& board, Rules::Id rules, size_t capacity);
+
+        // false for fields with cells at or above PC_HEIGHT, and for a capacity of 0
+        bool applicable() const { return fits && capacity > 0; }
+
+        // the path of a pooled pc the queue can make, with the nodes of the order search added to nodes
+        std::optional<std::vector<FullPiece>> find(const Queue& queue, uint64_t& nodes);
+
+        // remembers the pc of a witness, pushing out the least recently used one when the pool is full
+        void add(const std::vector<FullPiece>& witness);
+
+        size_t lookups() const { return lookup_count; }
+        size_t hits() const { return hit_count; }
+
+    private:
+        struct Solution {
+            std::vector<Tile> tiles;
+            uint32_t pieces;
+        };
+
+        PlacementOrder order;
+        bool can_hold;
+        bool fits;
+        size_t capacity;
+        std::deque<Solution> solutions;
+        size_t lookup_count = 0;
+        size_t hit_count = 0;
+    };
+};
@@ -1,13 +1,213 @@
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
 #include <thread>
 #include <print>
-
+#include <unordered_map>
+#include <unordered_set>
+
+#include "Movegen.hpp"
+#include "Nogood.hpp"
+#include "ShardedMap.hpp"
+#include "Solver.hpp"
+#include "Tiling.hpp"
 #include "Util.hpp"
 
 #include <board.hpp>
 
 namespace Solver {
+    // calls f(piece, new_game, lines_cleared, pieces_used) for every placement of the current and the hold piece
+    // that stays under the line limit, new_game is the game after the piece was placed and lines were cleared
+    // f returns true to stop the enumeration, which is what this returns as well
+    // movegen takes the game, whether the hold piece is the one being placed and the line limit,
+    // and returns its reachability boards
+    // the hold piece is only tried when the rules R have hold
+    template <typename R, typename F, typename Movegen>
+    static bool for_each_child(const Game& game, int pieces_used, int lines_left, F&& f, Movegen&& movegen) {
+        bool stop = false;
+        auto go = [&](reachability::static_vector<Board, 4UL> moves, bool held) {
+            const PieceType block_type = held ? game.hold.value_or(game.queue.front()) : game.current_piece;
+            // rotations of o, i, s and z that land on the same cells would only search the same field again
+            drop_rotation_twins(moves, block_type);
+            for (std::size_t rot = 0; rot < moves.size() && !stop; ++rot) {
+                const auto& reachable_board = moves[rot];
+                reachability::blocks::call_with_block<reachability::blocks::SRS>((char)block_type, [&]<reachability::block B>(){
+                    // the highest mino of this rotation has to stay under the line limit,
+                    // which caps the rows worth looking at for this rotation
+                    int top = B.minos[B.mino_index[rot]][0][1];
+                    reachability::static_for<B.BLOCK_PER_MINO>([&](const std::size_t mino_i) {
+                        top = std::max(top, (int)B.minos[B.mino_index[rot]][mino_i][1]);
+                    });
+
+                    for_each_set_cell(reachable_board, lines_left - top, [&](int x, int y) {
+                        const FullPiece piece{.type = block_type, .x = (int8_t)x, .y = (int8_t)y, .r = (int8_t)rot};
+                        Game new_game = game;
+                        bool held_first = new_game.place_piece(piece);
+                        int lines_cleared = new_game.board.clear_full_lines();
+
+                        stop = f(piece, new_game, lines_cleared, pieces_used + 1 + (held_first ? 1 : 0));
+                        return stop;
+                    });
+                });
+            }
+        };
+        go(movegen(game, false, lines_left), false);
+        if constexpr (R::hold) {
+            if (!stop)
+                go(movegen(game, true, lines_left), true);
+        }
+        return stop;
+    }
+
+    // movegen that only searches below the line limit
+    template <typename R>
+    struct bounded_movegen {
+        Moves operator()(const Game& game, bool held, int lines_left) const {
+            return held ? game.hold_piece_movegen<R>(lines_left) : game.current_piece_movegen<R>(lines_left);
+        }
+    };
+
+    template <typename R, typename F>
+    static bool for_each_child(const Game& game, int pieces_used, int lines_left, F&& f) {
+        return for_each_child<R>(game, pieces_used, lines_left, std::forward<F>(f), bounded_movegen<R>{});
+    }
+
+    std::optional<MoveOrder> parse_move_order(std::string_view name) {
+        if (name == "natural")
+            return MoveOrder::Natural;
+        if (name == "lowest")
+            return MoveOrder::Lowest;
+        if (name == "holes")
+            return MoveOrder::FewestHoles;
+        if (name == "flat")
+            return MoveOrder::Flattest;
+        return std::nullopt;
+    }
+
+    // lower is tried first, it only looks at the piece and the board it leaves so it stays cheap
+    static int move_score(MoveOrder order, const FullPiece& piece, const Game& new_game) {
+        int low = 0;
+        for (const auto& [x, y] : piece_cells(piece))
+            low += y;
+        if (order == MoveOrder::Lowest)
+            return low;
+
+        int holes = 0;
+        int bumps = 0;
+        int previous = -1;
+        for (int x = 0; x < (int)Board::width; ++x) {
+            const uint32_t column = column_bits(new_game.board, x);
+            const int height = std::bit_width(column);
+            holes += height - std::popcount(column);
+            if (previous >= 0)
+                bumps += std::abs(height - previous);
+            previous = height;
+        }
+        // the cells of a piece add up to less than 128, so the height only breaks ties
+        return (order == MoveOrder::FewestHoles ? holes : bumps) * 128 + low;
+    }
+
+    // for_each_child, but every child is made first and they are handed to f best first
+    template <typename R, typename F>
+    static bool for_each_child_in_order(const Game& game, int pieces_used, int lines_left, MoveOrder order, F&& f) {
+        if (order == MoveOrder::Natural)
+            return for_each_child<R>(game, pieces_used, lines_left, std::forward<F>(f));
+
+        struct Child {
+            int score;
+            FullPiece piece;
+            Game game;
+            int lines_cleared;
+            int pieces_used;
+        };
+        std::vector<Child> children;
+        for_each_child<R>(game, pieces_used, lines_left, [&](const FullPiece& piece, const Game& new_game, int lines_cleared, int used) {
+            children.push_back({move_score(order, piece, new_game), piece, new_game, lines_cleared, used});
+            return false;
+        });
+        std::stable_sort(children.begin(), children.end(), [](const Child& a, const Child& b) { return a.score < b.score; });
+
+        for (const Child& child : children)
+            if (f(child.piece, child.game, child.lines_cleared, child.pieces_used))
+                return true;
+        return false;
+    }
+
+    // decides when a search has run out of time or was asked to stop, shared by every thread of one search
+    class Watchdog {
+    public:
+        explicit Watchdog(const SearchLimits& limits)
+            : limits(limits), start(std::chrono::steady_clock::now()) {}
+
+        bool expired() const {
+            return fired.load(std::memory_order_relaxed);
+        }
+
+        // does the actual checks, the stop token is a single atomic load so it is checked every time
+        // the clock is only read every CLOCK_INTERVAL nodes
+        bool check(uint64_t nodes) {
+            if (limits.stop.stop_requested() ||
+                (limits.deadline.has_value() && nodes % CLOCK_INTERVAL == 0 && std::chrono::steady_clock::now() >= *limits.deadline)) {
+                fired.store(true, std::memory_order_relaxed);
+            }
+            return expired();
+        }
+
+        SearchResult finish(Status status, uint64_t nodes) const {
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            return {
+                .status = status,
+                .stats = {
+                    .nodes = nodes,
+                    .seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / 1e9}};
+        }
+
+    private:
+        static constexpr uint64_t CLOCK_INTERVAL = 16;
+
+        const SearchLimits& limits;
+        const std::chrono::steady_clock::time_point start;
+        std::atomic_bool fired = false;
+    };
+
+    // per thread node counter that asks the watchdog at every node
+    struct Ticker {
+        explicit Ticker(Watchdog& watchdog) : watchdog(watchdog) {}
+
+        bool expired() {
+            return watchdog.check(++nodes);
+        }
+
+        Watchdog& watchdog;
+        uint64_t nodes = 0;
+    };
+
+    // the first pc path found by any thread
+    class Witness {
+    public:
+        void offer(const std::vector<FullPiece>& path, const FullPiece& last) {
+            std::lock_guard lock(mutex);
+            if (found.has_value())
+                return;
+            found = path;
+            found->push_back(last);
+        }
+
+        std::optional<std::vector<FullPiece>> take() {
+            std::lock_guard lock(mutex);
+            return std::move(found);
+        }
+
+    private:
+        std::mutex mutex;
+        std::optional<std::vector<FullPiece>> found;
+    };
+
     struct can_pc_state {
         const Game& game;
         const Queue& queue;
@@ -18,14 +218,41 @@ namespace Solver {
         const int cleared_lines;
         // the number of lines that we are constraining the pc to happen in
         const int max_lines;
+        // this thread's view of the search limits
+        Ticker& ticker;
+        // where the path of the pc goes once one is found
+        Witness& witness;
+        // the dead state cache and move order
+        const SearchOptions& options;
     };
 
+    // how many of each piece a search state has left to place, counting the hold piece, nullopt if they don't fit a key
+    static std::optional<uint32_t> pieces_left(const Game& game, const Queue& queue, int pieces_used) {
+        uint32_t pieces = 0;
+        int count = 0;
+        if (game.hold.has_value() && *game.hold != PieceType::Empty) {
+            pieces = add_piece(pieces, *game.hold);
+            count++;
+        }
+        for (size_t i = pieces_used; i < queue.size(); i++, count++)
+            pieces = add_piece(pieces, queue[i]);
+        // 4 bits per piece type
+        if (count > 15)
+            return std::nullopt;
+        return pieces;
+    }
+
+    template <typename R>
     static bool can_pc_recurse(const can_pc_state& state, std::atomic_bool& solved) {
         // warning with returning out of this function, it means that we are skipping every other piece placement
         if (solved) {
             return true;
         }
 
+        if (state.ticker.expired()) {
+            return false;
+        }
+
         Game game = state.game;
 
         // copy the queue
@@ -87,136 +314,84 @@ namespace Solver {
 
         }  // columnar parity
 
+        // no order of the pieces left can fill the field, proven without searching and remembered for the whole run
+        const int lines_left = state.max_lines - state.cleared_lines;
+        if (NogoodCache* nogoods = state.options.nogoods; nogoods != nullptr) {
+            auto pieces = pieces_left(game, state.queue, state.pieces_used);
+            if (pieces.has_value() && nogoods->dead(game.board, lines_left, *pieces))
+                return false;
+        }
+
+        // the enumeration also stops once the deadline passed, so whether it stopped doesn't say whether there was a pc
+        bool found = false;
+        for_each_child_in_order<R>(game, state.pieces_used, lines_left, state.options.order,
+            [&](const FullPiece& piece, const Game& new_game, int lines_cleared, int pieces_used) {
+                // if we have cleared the max lines, we pc'd
+                if (state.cleared_lines + lines_cleared == state.max_lines) {
+                    state.witness.offer(state.path, piece);
+                    found = true;
+                    return true;
+                }
 
-        // possible piece placements
-        auto reachable = game.current_piece_movegen();
+                // if the board is empty we have an early pc
+                if (!new_game.board.any()) {
+                    state.witness.offer(state.path, piece);
+                    found = true;
+                    return true;
+                }
 
-        std::optional<bool> return_value;
-        auto go = [&](const reachability::static_vector<Board, 4UL>&moves, bool held){
-            
-            for(std::size_t rot = 0; rot < moves.size(); ++rot) {
-                const auto &reachable_board = moves[rot];
-                if(return_value.has_value())
-                    return return_value.value();
-                const PieceType block_type = held ? game.hold.value_or(game.queue.front()) : game.current_piece;
-                reachability::blocks::call_with_block<reachability::blocks::SRS>((char)block_type, [&]<reachability::block B>(){
-                    reachability::static_for<Board::height>([&] (auto y) {
-                        if(return_value.has_value())
-                            return;
-                        reachability::static_for<Board::width>([&] (auto x) {
-                            if(return_value.has_value())
-                                return;
-                            if (reachable_board.template get<x,y>()) {
-                                Board new_board = game.board;
-                                bool valid = true;
-                                reachability::static_for<B.BLOCK_PER_MINO>([&](const std::size_t mino_i) {
-                                    int px = x + (B.minos[B.mino_index[rot]][mino_i][0]);
-                                    int py = y + (B.minos[B.mino_index[rot]][mino_i][1]);
-                                    // new_board.set(px, py);
-
-                                    valid &= (py < (state.max_lines - state.cleared_lines));
-                                });
-                                if(x==5 and y==2 and block_type == PieceType::T and rot == RotationDirection::East) {
-                                    //std::println("{}", valid);
-                                }
-                                if (!valid) {
-                                    return;
-                                }
-                                // if we are here, the piece placement is valid
-
-                                Game new_game = game;
-
-                                // place the piece
-                                bool held_first = new_game.place_piece(FullPiece{.type=block_type, .x=(int8_t)x, .y=(int8_t)y, .r=(int8_t)rot});
-
-                                int lines_cleared = new_game.board.clear_full_lines();
-
-
-                                // if the piece was held, we need to increment the pieces used
-                                int pieces_used = state.pieces_used + 1;
-                                if (held_first) {
-                                    pieces_used++;
-                                }
-
-                                // if we have cleared the max lines, we pc'd
-                                if (state.cleared_lines + lines_cleared == state.max_lines) {
-                                    return_value = true;
-                                    return;
-                                }
-
-                                // if the board is empty we have an early pc
-                                if (!new_game.board.any()) {
-                                    return_value = true;
-                                    return;
-                                }
-
-                                // if we have used all the pieces in the queue, we can't pc
-                                if (pieces_used == state.queue.size()) {
-                                    return;
-                                }
-
-                                int lines_left = state.max_lines - state.cleared_lines - lines_cleared;
-
-                                // {
-                                //     // has_isolated_cell https://github.com/wirelyre/tetra-tools/blob/2342953cb424cfd5ca94fa8eefdbe5434bd5ff1c/srs-4l/src/gameplay.rs#L169
-                                //     u32 not_empty = new_game.not_empty(lines_left);
-                                //     u32 full = new_game.full(lines_left);
-                                //     u32 bounded = new_game.bounded(lines_left);
-                                //     if ((not_empty & (~full) & bounded) != 0) {
-                                //         return;
-                                //     }
-                                // }
-
-                                // if (new_game.board.has_imbalanced_split(lines_left))
-                                //     return;
-
-                                if (T_should_be_horizontal && block_type == PieceType::T) {
-                                    if (rot == RotationDirection::North || rot == RotationDirection::South) {
-                                        //return;
-                                    }
-                                }
-
-                                if (T_should_be_vertical && block_type == PieceType::T) {
-                                    if (rot == RotationDirection::East || rot == RotationDirection::West) {
-                                        //return;
-                                    }
-                                }
-
-                                state.path.emplace_back(FullPiece{.type=block_type, .x=(int8_t)x, .y=(int8_t)y, .r=(int8_t)rot});
-                                // we havent pc'd yet and we have more pieces to use
-                                // recurse
-                                if (can_pc_recurse(
-                                        {.game = new_game,
-                                        .queue = state.queue,
-                                        .path = state.path,
-                                        .pieces_used = pieces_used,
-                                        .cleared_lines = state.cleared_lines + lines_cleared,
-                                        .max_lines = state.max_lines},
-                                        solved)) {
-                                    return_value = true;
-                                    return;
-                                }
-                                state.path.pop_back();
-                            }
-                        });
-                    });
-                });
-                if(return_value.has_value())
-                    return return_value.value();
-            }
-            return return_value.value_or(false);
-        };
-        go(reachable,false);
-        if(return_value.has_value())
-            return return_value.value();
-        auto reachable2 = game.hold_piece_movegen();
-        if(game.hold.value_or(game.queue.front()) != PieceType::Empty)
-            go(reachable2, true);
-        return return_value.value_or(false);
+                // if we have used all the pieces in the queue, we can't pc
+                if (pieces_used == state.queue.size()) {
+                    return false;
+                }
+
+                if (T_should_be_horizontal && piece.type == PieceType::T) {
+                    if (piece.r == RotationDirection::North || piece.r == RotationDirection::South) {
+                        //return false;
+                    }
+                }
+
+                if (T_should_be_vertical && piece.type == PieceType::T) {
+                    if (piece.r == RotationDirection::East || piece.r == RotationDirection::West) {
+                        //return false;
+                    }
+                }
+
+                state.path.emplace_back(piece);
+                // we havent pc'd yet and we have more pieces to use
+                // recurse
+                if (can_pc_recurse<R>(
+                        {.game = new_game,
+                        .queue = state.queue,
+                        .path = state.path,
+                        .pieces_used = pieces_used,
+                        .cleared_lines = state.cleared_lines + lines_cleared,
+                        .max_lines = state.max_lines,
+                        .ticker = state.ticker,
+                        .witness = state.witness,
+                        .options = state.options},
+                        solved)) {
+                    found = true;
+                    return true;
+                }
+                state.path.pop_back();
+                // the siblings would only be placed to find out the time is up
+                return state.ticker.watchdog.expired();
+            });
+        return found;
     }
 
     // returns whether or not a pc is possible
     bool can_pc(const Board& board, const Queue& queue) {
+        return can_pc(board, queue, {}).status == Status::Solved;
+    }
+
+    template <typename R>
+    static SearchResult can_pc_search(const Board& board, const Queue& queue, const SearchLimits& limits, const SearchOptions& options) {
+        Watchdog watchdog(limits);
+        if (queue.empty())
+            return watchdog.finish(Status::Unsolvable, 0);
+
         Game game;
         game.board = board;
         game.current_piece = queue[0];
@@ -224,422 +399,874 @@ namespace Solver {
         for (size_t i = 1; i < QUEUE_SIZE && i < queue.size(); i++) {
             game.queue[i - 1] = queue[i];
         }
-        const auto ppp = game.current_piece_movegen();
-        const auto pppp = game.hold_piece_movegen();
-        const int max_lines = 4;
+        const int max_lines = PC_HEIGHT;
 
         std::atomic_bool atomic_solved = false;
+        Witness witness;
 
-        int size_acc = 0;
-        for (auto& pp : std::span{ppp.data, ppp.size()}) {
-            size_acc += pp.popcount();
-        }
-        for (auto& ppppp : std::span{pppp.data, pppp.size()}) {
-            size_acc += ppppp.popcount();
-        }
-
-        std::vector<std::jthread> threads(size_acc);
-        std::vector<u8> return_values(size_acc, 0);
-        //std::println("{}", size_acc);
-
-        int i = 0;
-        auto go = [&] (const reachability::static_vector<Board, 4UL>& moves, bool held) {
-            for(std::size_t rot = 0; rot < moves.size(); ++rot) {
-                const auto &reachable_board = moves[rot];
-                auto block_type = held ? game.queue[0] : game.current_piece;
-                reachability::blocks::call_with_block<reachability::blocks::SRS>(block_type, [&]<reachability::block B>(){
-                    reachability::static_for<Board::height>([&] (auto y) {
-                        reachability::static_for<Board::width>([&] (auto x) {
-                            if (reachable_board.template get<x,y>()) {
-
-                                #ifdef MULTITHREADED
-                                threads[i] = std::jthread(
-                                #else
-
-                                bool already_solved = false;
-                                for (auto return_value : return_values) {
-                                    already_solved |= return_value;
-                                }
-                                if(already_solved) return;
-                                #endif
-                                [block_type=block_type,held=held,rot=rot,x=x,y=y,game, queue, &atomic_solved, max_lines, &return_value = return_values[i]]() {
-                                    Game new_game = game;
-                                    FullPiece p = {.type = block_type, .x = (int8_t)x, .y = (int8_t)y, .r = (int8_t)rot};
-                                    bool first_hold = held;
-                                    auto& new_board = new_game.board;
-
-                                    // make sure the piece is valid
-                                    bool valid = true;
-                                    reachability::static_for<B.BLOCK_PER_MINO>([&](const std::size_t mino_i) {
-                                        int px = x + (B.minos[B.mino_index[rot]][mino_i][0]);
-                                        int py = y + (B.minos[B.mino_index[rot]][mino_i][1]);
-                                        valid &= (py < (max_lines - 0)); // 0 => cleared lines
-                                    });
-                                    
-                                    if(x==5 and y==2 and block_type == PieceType::T and rot == RotationDirection::East) {
-                                        //std::println("{}", valid);
-                                    }
-
-                                    if (!valid)
-                                        return;
-                                    
-                                    new_game.place_piece(p);
-                                    auto before = new_game.board;
-
-                                    int lines_cleared = new_game.board.clear_full_lines();
-                                    if(lines_cleared != 0) {
-                                        //std::println("beofre:\n{}\nafter\n{}", to_string(before), to_string(new_game.board));
-                                    }
-                                    
-                                    if (lines_cleared == max_lines) {
-                                        atomic_solved = true;
-                                        return_value = true;
-                                        return;
-                                    }
-                                    int pieces_used = 1;
-                                    
-                                    if (first_hold) {
-                                        pieces_used++;
-                                    }
-                                    
-                                    std::vector<FullPiece> path{};
-                                    path.emplace_back(p);
-                                    bool local_solved = can_pc_recurse({
-                                        .game = new_game,
-                                        .queue = queue,
-                                        .path = path,
-                                        .pieces_used = pieces_used,
-                                        .cleared_lines = lines_cleared,
-                                        .max_lines = max_lines }, atomic_solved);
-                                        
-                                        if (local_solved) {
-                                            atomic_solved = true;
-                                            return_value = true;
-                                        }
-                                        return;
-                                    }
-                                #ifdef MULTITHREADED
-                                );
-                                #else
-                                ();
-                                #endif
-                                ++i;
-                            }
-                        });
-                    });
-                });
-            }
-        };
+        // one ticker per first placement, deque so they stay put while threads hold on to them
+        std::deque<Ticker> tickers;
+
+        #ifdef MULTITHREADED
+        std::vector<std::jthread> threads;
+        #endif
 
-        go(ppp,false);
-        go(pppp,true);
+        for_each_child_in_order<R>(game, 0, max_lines, options.order, [&](const FullPiece& piece, const Game& new_game, int lines_cleared, int pieces_used) {
+            #ifndef MULTITHREADED
+            if (atomic_solved || watchdog.expired())
+                return true;
+            #endif
+
+            Ticker& ticker = tickers.emplace_back(watchdog);
+            auto search = [&queue, &atomic_solved, &ticker, &witness, &options, piece, new_game, lines_cleared, pieces_used, max_lines]() {
+                if (lines_cleared == max_lines || !new_game.board.any()) {
+                    witness.offer({}, piece);
+                    atomic_solved = true;
+                    return;
+                }
+                if (pieces_used == queue.size())
+                    return;
+
+                std::vector<FullPiece> path{piece};
+                bool local_solved = can_pc_recurse<R>({
+                    .game = new_game,
+                    .queue = queue,
+                    .path = path,
+                    .pieces_used = pieces_used,
+                    .cleared_lines = lines_cleared,
+                    .max_lines = max_lines,
+                    .ticker = ticker,
+                    .witness = witness,
+                    .options = options }, atomic_solved);
+
+                if (local_solved)
+                    atomic_solved = true;
+            };
+
+            #ifdef MULTITHREADED
+            threads.emplace_back(search);
+            #else
+            search();
+            #endif
+            return false;
+        });
 
         #ifdef MULTITHREADED
-        for (auto& thread : threads) {
-            thread.join();
-        }
+        threads.clear();
         #endif
 
-        bool ret = false;
-        for (auto return_value : return_values) {
-            ret |= return_value;
+        uint64_t nodes = 0;
+        for (const Ticker& ticker : tickers)
+            nodes += ticker.nodes;
+
+        if (atomic_solved) {
+            SearchResult result = watchdog.finish(Status::Solved, nodes);
+            result.witness = witness.take();
+            return result;
+        }
+        return watchdog.finish(watchdog.expired() ? Status::TimedOut : Status::Unsolvable, nodes);
+    }
+
+    SearchResult can_pc(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules) {
+        return can_pc(board, queue, limits, rules, SearchOptions{});
+    }
+
+    SearchResult can_pc(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules, const SearchOptions& options) {
+        return Rules::visit(rules, [&]<typename R>() { return can_pc_search<R>(board, queue, limits, options); });
+    }
+
+    // a pc is the same pc no matter what order its pieces went down in, so it is keyed by
+    // the cells each piece covers in the coordinates of the starting board
+    // every entry is the piece type in the top byte and its cells as bit (y * 10 + x) below it
+    using SolutionKey = std::vector<uint64_t>;
+
+    struct SolutionKeyHash {
+        size_t operator()(const SolutionKey& key) const {
+            uint64_t hash = 0xcbf29ce484222325ULL;
+            for (uint64_t entry : key) {
+                hash ^= entry;
+                hash *= 0x100000001b3ULL;
+                hash ^= hash >> 29;
+            }
+            return hash;
         }
-        return ret;
+    };
+
+    static SolutionKey canonical_key(const Board& board, const std::vector<FullPiece>& path, int max_lines) {
+        constexpr uint16_t FULL_ROW = (1 << Board::width) - 1;
+
+        // occupancy of the rows that are still on the board, and which starting row each of them was
+        const auto board_occupancy = board_rows(board);
+        std::vector<uint16_t> rows(board_occupancy.begin(), board_occupancy.begin() + max_lines);
+        std::vector<int> origin(max_lines);
+        for (int y = 0; y < max_lines; ++y)
+            origin[y] = y;
+
+        SolutionKey key;
+        key.reserve(path.size());
+        for (const FullPiece& piece : path) {
+            uint64_t cells = 0;
+            for (const auto& [x, y] : piece_cells(piece)) {
+                cells |= 1ULL << (origin[y] * Board::width + x);
+                rows[y] |= 1 << x;
+            }
+            key.push_back((uint64_t(piece.type) << 56) | cells);
+
+            for (int y = int(rows.size()) - 1; y >= 0; --y) {
+                if (rows[y] == FULL_ROW) {
+                    rows.erase(rows.begin() + y);
+                    origin.erase(origin.begin() + y);
+                }
+            }
+        }
+        std::sort(key.begin(), key.end());
+        return key;
     }
 
+    // concurrent set of the solutions found so far
+    class SolutionSet {
+    public:
+        void insert(SolutionKey key, const std::vector<FullPiece>& path) {
+            solutions.with(key, [&](auto& shard) {
+                auto [it, inserted] = shard.try_emplace(std::move(key));
+                if (inserted)
+                    it->second.path = path;
+                it->second.orderings++;
+            });
+        }
+
+        std::vector<Solution> take() {
+            std::vector<Solution> taken;
+            solutions.for_each([&](auto& shard) {
+                for (auto& [key, solution] : shard)
+                    taken.push_back(std::move(solution));
+                shard.clear();
+            });
+            return taken;
+        }
+
+    private:
+        ShardedMap<SolutionKey, Solution, SolutionKeyHash> solutions;
+    };
+
     struct solve_pcs_state {
         const Game& game;
         const Queue& queue;
+        // the board the search started from, used to canonicalize solutions
+        const Board& start;
         std::vector<FullPiece>& path;
         // solutions we found
-        std::vector<std::vector<FullPiece>>& solutions;
+        SolutionSet& solutions;
         // pieces used thus far in the queue
         const int pieces_used;
         // lines cleared thus far
         const int cleared_lines;
         // the number of lines that we are constraining the pc to happen in
         const int max_lines;
+        // this thread's view of the search limits
+        Ticker& ticker;
     };
 
-    static void solve_pcs_recurse(const solve_pcs_state& state) {}
-    
-    /*
+    template <typename R>
+    static void solve_pcs_recurse(const solve_pcs_state& state);
+
+    // handles the state right after a piece was placed, the piece is already at the end of the path
+    template <typename R>
+    static void solve_pcs_child(const solve_pcs_state& parent, const Game& new_game, int lines_cleared, int pieces_used) {
+        // if we have cleared the max lines, or the board is empty early, we pc'd
+        if (parent.cleared_lines + lines_cleared == parent.max_lines || !new_game.board.any()) {
+            parent.solutions.insert(canonical_key(parent.start, parent.path, parent.max_lines), parent.path);
+            return;
+        }
+
+        // if we have used all the pieces in the queue, we can't pc
+        if (pieces_used == parent.queue.size())
+            return;
+
+        solve_pcs_recurse<R>({
+            .game = new_game,
+            .queue = parent.queue,
+            .start = parent.start,
+            .path = parent.path,
+            .solutions = parent.solutions,
+            .pieces_used = pieces_used,
+            .cleared_lines = parent.cleared_lines + lines_cleared,
+            .max_lines = parent.max_lines,
+            .ticker = parent.ticker});
+    }
+
+    template <typename R>
     static void solve_pcs_recurse(const solve_pcs_state& state) {
-        // warning with returning out of this function, it means that we are skipping every other piece placement
+        if (state.ticker.expired())
+            return;
 
         Game game = state.game;
 
-        // copy the current piece
-        game.current_piece = state.queue[state.pieces_used];
-
         // copy the queue
-        for (size_t i = 0;  i < QUEUE_SIZE   &&    i + state.pieces_used + 1 < state.queue.size(); i++) {
-            game.queue[i] = state.queue[i + state.pieces_used + 1];
+        for (size_t i = 0; i < QUEUE_SIZE && i + state.pieces_used + 1 < state.queue.size(); i++) {
+            game.queue.at(i) = state.queue.at(i + state.pieces_used + 1);
         }
 
+        for_each_child<R>(game, state.pieces_used, state.max_lines - state.cleared_lines,
+            [&](const FullPiece& piece, const Game& new_game, int lines_cleared, int pieces_used) {
+                state.path.push_back(piece);
+                solve_pcs_child<R>(state, new_game, lines_cleared, pieces_used);
+                state.path.pop_back();
+                return state.ticker.watchdog.expired();
+            });
+    }
 
-        // columnar state to check for if the T piece should be placed in a certain orientation
-        bool T_should_be_vertical = false;
-        bool T_should_be_horizontal = false;
+    std::vector<Solution> solve_unique_pcs(const Board& board, const Queue& queue) {
+        return solve_unique_pcs(board, queue, {}).solutions;
+    }
 
-        // columnar parity checking this is mega nerd stuff
-        // https://docs.google.com/document/d/1udtq235q2SdoFYwMZNu-GRYR-4dCYMkp0E8_Hw1XTyg/edit#heading=h.z6ne0og04bp5
-        // this is the link to the document that explains Perfect Clear Theory
-        // i dont understand much of this apparently it just works
-        {  
-            u32 empty_cells = game.empty_cells(state.max_lines - state.cleared_lines);
-            // this only works because we constrain the queue to be
-            // exactly the number of pieces that fills the max_pc
-            const size_t lookahead = empty_cells / 4;
+    template <typename R>
+    static SolveResult solve_unique_pcs_search(const Board& board, const Queue& queue, const SearchLimits& limits) {
+        Watchdog watchdog(limits);
+        if (queue.empty())
+            return {.search = watchdog.finish(Status::Unsolvable, 0)};
 
-            int t_count = 0;
-            for (size_t i = 0; i < lookahead; i++) {
-                if (state.queue[i + state.pieces_used] == PieceType::T) {
-                    t_count++;
-                }
-            }
+        Game game;
+        game.board = board;
+        game.current_piece = queue[0];
+        game.queue.fill(PieceType::Empty);
+        for (size_t i = 1; i < QUEUE_SIZE && i < queue.size(); i++) {
+            game.queue[i - 1] = queue[i];
+        }
+        const int max_lines = PC_HEIGHT;
 
-            if (game.hold.has_value() && game.hold.value() == PieceType::T)
-                t_count++;
+        SolutionSet solutions;
+        std::deque<Ticker> tickers;
 
-            if (game.current_piece.type == PieceType::T)
-                t_count++;
+        #ifdef MULTITHREADED
+        std::vector<std::jthread> threads;
+        #endif
 
-            // check the hold piece as well as lookahead - 1 pieces in the queue
-            int columnar_parity = 0;
+        for_each_child<R>(game, 0, max_lines, [&](const FullPiece& piece, const Game& new_game, int lines_cleared, int pieces_used) {
+            #ifndef MULTITHREADED
+            if (watchdog.expired())
+                return true;
+            #endif
+
+            Ticker& ticker = tickers.emplace_back(watchdog);
+            auto search = [&board, &queue, &solutions, &ticker, piece, new_game, lines_cleared, pieces_used, max_lines]() {
+                std::vector<FullPiece> path{piece};
+                solve_pcs_child<R>({
+                    .game = new_game,
+                    .queue = queue,
+                    .start = board,
+                    .path = path,
+                    .solutions = solutions,
+                    .pieces_used = 0,
+                    .cleared_lines = 0,
+                    .max_lines = max_lines,
+                    .ticker = ticker}, new_game, lines_cleared, pieces_used);
+            };
+            #ifdef MULTITHREADED
+            threads.emplace_back(search);
+            #else
+            search();
+            #endif
+            return false;
+        });
 
-            for (size_t i = 0; i < lookahead - 1; i++)
-                if (state.queue[i + state.pieces_used] == PieceType::J || state.queue[i + state.pieces_used] == PieceType::L)
-                    columnar_parity++;
+        #ifdef MULTITHREADED
+        threads.clear();
+        #endif
 
-            for (const auto& piece : state.path) {
-                if (piece.type == PieceType::J || piece.type == PieceType::L)
-                    columnar_parity++;
-                if (piece.type == PieceType::T && piece.rotation == RotationDirection::North || piece.rotation == RotationDirection::South)
-                    columnar_parity++;
-            }
+        uint64_t nodes = 0;
+        for (const Ticker& ticker : tickers)
+            nodes += ticker.nodes;
 
-            if (t_count == 0) {
-                // count the number of J and L pieces used and left in the queue
-                // as well as the number of vertical Ts in the path
-                // if the sum of these is odd, we have an invalid columnar parity
-                // the pc isnt possible here
-                if (columnar_parity % 2 == 1)
-                    return;
-            } else if (t_count == 1) {
-                // if we have a single T piece, we need to make sure this T piece is vertical to account for the columnar parity
-                if (columnar_parity % 2 == 1)
-                    T_should_be_vertical = true;
-                else
-                    T_should_be_horizontal = true;
-            }
+        SolveResult result{.solutions = solutions.take()};
+        if (watchdog.expired())
+            result.search = watchdog.finish(Status::TimedOut, nodes);
+        else
+            result.search = watchdog.finish(result.solutions.empty() ? Status::Unsolvable : Status::Solved, nodes);
+        return result;
+    }
 
-        }  // columnar parity 
+    SolveResult solve_unique_pcs(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules) {
+        return Rules::visit(rules, [&]<typename R>() { return solve_unique_pcs_search<R>(board, queue, limits); });
+    }
 
+    // t-spin detection by the 3 corner rule, the movegen does not say how a piece got to its spot
+    // so the last move is taken to be a rotation whenever the t could not have been moved up out of it
+    static Spin t_spin(const std::array<uint16_t, Board::height>& rows, const FullPiece& piece) {
+        if (piece.type != PieceType::T)
+            return Spin::null;
+
+        auto filled = [&](int x, int y) {
+            if (x < 0 || x >= (int)Board::width || y < 0)
+                return true;
+            if (y >= (int)Board::height)
+                return false;
+            return ((rows[y] >> x) & 1) != 0;
+        };
 
-        // possible piece placements
-        auto ppp = game.current_piece_movegen();
-        auto pppp = game.hold_piece_movegen();
-        
-        for (auto& pp : ppp) {
-            // object that I can just make that does the pop and push for recursive calls to have the correct path
-            struct path_updater {
-                std::vector<FullPiece>& path;
+        bool can_move_up = true;
+        for (const auto& [x, y] : piece_cells(piece))
+            can_move_up &= !filled(x, y + 1);
+        if (can_move_up)
+            return Spin::null;
+
+        // corners in the order top left, top right, bottom right, bottom left
+        const std::array<bool, 4> corners = {
+            filled(piece.x - 1, piece.y + 1),
+            filled(piece.x + 1, piece.y + 1),
+            filled(piece.x + 1, piece.y - 1),
+            filled(piece.x - 1, piece.y - 1)};
+
+        if (std::count(corners.begin(), corners.end(), true) < 3)
+            return Spin::null;
+
+        // the two corners the flat side of the t points away from, north looks at the top corners
+        const bool front = corners[piece.r % 4] && corners[(piece.r + 1) % 4];
+        return front ? Spin::normal : Spin::mini;
+    }
 
-                path_updater(std::vector<FullPiece>& path, const FullPiece& pp) : path(path) {
-                    path.emplace_back(pp);
-                }
-                ~path_updater() {
-                    path.pop_back();
+    template <typename Scorer>
+    struct best_pc_state {
+        const Game& game;
+        const Queue& queue;
+        std::vector<FullPiece>& path;
+        // scorer state after the pieces in the path, it carries the combo and b2b
+        const Scorer& scorer;
+        // points scored by the pieces in the path
+        const int score;
+        // best pc found so far, the bound every other branch has to beat
+        std::optional<ScoredPath>& best;
+        // pieces used thus far in the queue
+        const int pieces_used;
+        // lines cleared thus far
+        const int cleared_lines;
+        // the number of lines that we are constraining the pc to happen in
+        const int max_lines;
+    };
+
+    template <typename R, typename Scorer>
+    static void best_pc_recurse(const best_pc_state<Scorer>& state) {
+        Game game = state.game;
+
+        // copy the queue
+        for (size_t i = 0; i < QUEUE_SIZE && i + state.pieces_used + 1 < state.queue.size(); i++) {
+            game.queue.at(i) = state.queue.at(i + state.pieces_used + 1);
+        }
+
+        // only needed for t-spin detection, so only built when there is a t to place
+        std::optional<std::array<uint16_t, Board::height>> rows;
+
+        for_each_child<R>(game, state.pieces_used, state.max_lines - state.cleared_lines,
+            [&](const FullPiece& piece, const Game& new_game, int lines_cleared, int pieces_used) {
+                Spin spin = Spin::null;
+                if (piece.type == PieceType::T) {
+                    if (!rows.has_value())
+                        rows = board_rows(game.board);
+                    spin = t_spin(*rows, piece);
                 }
-            } updater(state.path, pp);
 
-            // prune out every invalid piece placement
-            // aka the ones that go against the max_lines constraint
+                const int cleared_lines = state.cleared_lines + lines_cleared;
+                const bool pc = cleared_lines == state.max_lines || !new_game.board.any();
+
+                Scorer scorer = state.scorer;
+                const int score = state.score + scorer.calculate({.linesCleared = lines_cleared, .spin = spin, .pc = pc});
 
-            bool valid = true;
-            for (auto& mino : pp.minos) {
-                if (pp.position.y + mino.y >= (state.max_lines - state.cleared_lines)) {
-                    valid = false;
+                state.path.push_back(piece);
+
+                if (pc) {
+                    if (!state.best.has_value() || score > state.best->score)
+                        state.best = ScoredPath{.path = state.path, .score = score};
+                }
+                else if (pieces_used < state.queue.size()) {
+                    const int lines_left = state.max_lines - cleared_lines;
+                    const int pieces_left = int(state.queue.size() - state.path.size());
+
+                    // not enough pieces left to fill the rest of the lines
+                    const bool fillable = new_game.empty_cells(lines_left) <= pieces_left * 4;
+
+                    // only worth going deeper if the most this branch could still score beats the best pc
+                    const bool promising = !state.best.has_value() ||
+                        score + scorer.remaining_bound(pieces_left, lines_left) > state.best->score;
+
+                    if (fillable && promising) {
+                        best_pc_recurse<R, Scorer>({
+                            .game = new_game,
+                            .queue = state.queue,
+                            .path = state.path,
+                            .scorer = scorer,
+                            .score = score,
+                            .best = state.best,
+                            .pieces_used = pieces_used,
+                            .cleared_lines = cleared_lines,
+                            .max_lines = state.max_lines});
+                    }
                 }
-            }
 
-            if (!valid) {
-                continue;
-            }
-            Game new_game = game;
+                state.path.pop_back();
+                return false;
+            });
+    }
 
-            // place the piece
-            bool held_first = new_game.place_piece(pp);
-            int lines_cleared = new_game.board.clear_full_lines();
+    std::optional<ScoredPath> best_pc(const Board& board, const Queue& queue, const Scorer& scorer, Rules::Id rules) {
+        if (queue.empty())
+            return std::nullopt;
 
-            // if the piece was held, we need to increment the pieces used
-            int pieces_used = state.pieces_used + 1;
-            if (held_first) {
-                pieces_used++;
-            }
+        Game game;
+        game.board = board;
+        game.current_piece = queue[0];
+        game.queue.fill(PieceType::Empty);
+        for (size_t i = 1; i < QUEUE_SIZE && i < queue.size(); i++) {
+            game.queue[i - 1] = queue[i];
+        }
+        const int max_lines = PC_HEIGHT;
 
-            // if we have cleared the max lines, we pc'd
-            if (state.cleared_lines + lines_cleared == state.max_lines) {
-                // save the path to the solutions
-                state.solutions.push_back(state.path);
+        std::optional<ScoredPath> best;
+        std::vector<FullPiece> path;
 
-                continue;
-            }
+        // pick the rules and scorer once here so the search itself only sees the concrete types
+        Rules::visit(rules, [&]<typename R>() {
+            std::visit([&]<typename S>(const S& concrete) {
+                best_pc_recurse<R, S>({
+                    .game = game,
+                    .queue = queue,
+                    .path = path,
+                    .scorer = concrete,
+                    .score = 0,
+                    .best = best,
+                    .pieces_used = 0,
+                    .cleared_lines = 0,
+                    .max_lines = max_lines});
+            }, scorer);
+        });
 
-            // if the board is empty we have an early pc
-            if (new_game.board.is_empty()) {
-                state.solutions.push_back(state.path);
-                continue;
-            }
+        return best;
+    }
 
-            // if we have used all the pieces in the queue, we can't pc because the board isnt empty for some reason
-            // definitely need to check this
-            if (pieces_used == state.queue.size()) [[unlikely]] {
-                // this might actually be wrong, but this probably means that
-                // the queue isnt large enough if we got here and didnt PC
-                // there should be a check before this function is ever called in order to
-                // ensure that the queue is large enough
-                throw;
-                continue;
-            }
+    // a search node, the rest of the queue follows from the pieces used
+    struct NodeKey {
+        Board board;
+        PieceType current;
+        std::optional<PieceType> hold;
+        int pieces_used;
+    };
+    struct NodeKeyHash {
+        size_t operator()(const NodeKey& key) const noexcept {
+            size_t hash = BoardHash{}(key.board);
+            hash ^= (size_t(key.current) << 8 | size_t(key.hold.value_or(PieceType::Empty))) * 0x9e3779b97f4a7c15ULL;
+            return hash ^ (size_t(key.pieces_used) << 32);
+        }
+    };
+    struct NodeKeyEqual {
+        bool operator()(const NodeKey& a, const NodeKey& b) const noexcept {
+            return a.current == b.current && a.hold == b.hold && a.pieces_used == b.pieces_used && BoardEqual{}(a.board, b.board);
+        }
+    };
 
-            int lines_left = state.max_lines - state.cleared_lines - lines_cleared;
-
-            {
-                // bit maggic stuff, dont ask me it just works apparently
-                // has_isolated_cell https://github.com/wirelyre/tetra-tools/blob/2342953cb424cfd5ca94fa8eefdbe5434bd5ff1c/srs-4l/src/gameplay.rs#L169
-                u32 not_empty = new_game.board.not_empty(lines_left);
-                u32 full = new_game.board.full(lines_left);
-                u32 bounded = new_game.board.bounded(lines_left);
-                if ((not_empty & (~full) & bounded) != 0) {
-                    // creates an isolated cell, bad piece placement
-                    continue;
-                }
-            }
+    struct earliest_pc_state {
+        const Game& game;
+        const Queue& queue;
+        std::vector<FullPiece>& path;
+        // shared by every depth of the deepening
+        MovegenCache& movegen;
+        // nodes already shown to have no pc at this depth
+        std::unordered_set<NodeKey, NodeKeyHash, NodeKeyEqual>& dead;
+        // pieces used thus far in the queue
+        const int pieces_used;
+        // lines cleared thus far
+        const int cleared_lines;
+        // the number of lines that we are constraining the pc to happen in
+        const int max_lines;
+    };
 
-            // https://github.com/wirelyre/tetra-tools/blob/2342953cb424cfd5ca94fa8eefdbe5434bd5ff1c/srs-4l/src/gameplay.rs#L240
-            // this also just works
-            if (new_game.board.has_imbalanced_split(lines_left))
-            {
-                // bad piece placement, it makes an imbalanced split
+    template <typename R>
+    static bool earliest_pc_recurse(const earliest_pc_state& state) {
+        Game game = state.game;
+
+        // copy the queue
+        for (size_t i = 0; i < QUEUE_SIZE && i + state.pieces_used + 1 < state.queue.size(); i++) {
+            game.queue.at(i) = state.queue.at(i + state.pieces_used + 1);
+        }
+
+        NodeKey key{.board = game.board, .current = game.current_piece, .hold = game.hold, .pieces_used = state.pieces_used};
+        if (state.dead.contains(key))
+            return false;
+
+        bool found = for_each_child<R>(game, state.pieces_used, state.max_lines - state.cleared_lines,
+            [&](const FullPiece& piece, const Game& new_game, int lines_cleared, int pieces_used) {
+                state.path.push_back(piece);
+
+                if (state.cleared_lines + lines_cleared == state.max_lines)
+                    return true;
+
+                if (pieces_used < state.queue.size() && earliest_pc_recurse<R>({
+                        .game = new_game,
+                        .queue = state.queue,
+                        .path = state.path,
+                        .movegen = state.movegen,
+                        .dead = state.dead,
+                        .pieces_used = pieces_used,
+                        .cleared_lines = state.cleared_lines + lines_cleared,
+                        .max_lines = state.max_lines}))
+                    return true;
+
+                state.path.pop_back();
+                return false;
+            }, state.movegen);
+
+        if (!found)
+            state.dead.insert(key);
+        return found;
+    }
+
+    template <typename R>
+    static std::optional<EarliestPC> earliest_pc_search(const Board& board, const Queue& queue) {
+        if (queue.empty())
+            return std::nullopt;
+
+        Game game;
+        game.board = board;
+        game.current_piece = queue[0];
+        game.queue.fill(PieceType::Empty);
+        for (size_t i = 1; i < QUEUE_SIZE && i < queue.size(); i++) {
+            game.queue[i - 1] = queue[i];
+        }
+        const int max_lines = PC_HEIGHT;
+
+        const auto rows = board_rows(board);
+        int stack_height = 0;
+        for (int y = 0; y < (int)Board::height; ++y)
+            if (rows[y] != 0)
+                stack_height = y + 1;
+
+        const int filled = board.popcount();
+        MovegenCache movegen(Rules::id<R>());
+
+        // a pc in n lines takes exactly (10n - filled) / 4 pieces, so deepening over the line count is deepening over the
+        // piece count, and line counts whose empty cells are not a multiple of 4 are skipped without searching
+        for (int lines = std::max(stack_height, 1); lines <= max_lines; ++lines) {
+            const int empty = lines * (int)Board::width - filled;
+            if (empty <= 0 || empty % 4 != 0)
                 continue;
-            }
+            if (empty / 4 > (int)queue.size())
+                break;
+
+            std::unordered_set<NodeKey, NodeKeyHash, NodeKeyEqual> dead;
+            std::vector<FullPiece> path;
+            bool found = earliest_pc_recurse<R>({
+                .game = game,
+                .queue = queue,
+                .path = path,
+                .movegen = movegen,
+                .dead = dead,
+                .pieces_used = 0,
+                .cleared_lines = 0,
+                .max_lines = lines});
+
+            if (found)
+                return EarliestPC{.path = std::move(path), .lines = lines};
+        }
+        return std::nullopt;
+    }
 
-            if (T_should_be_horizontal && pp.type == PieceType::T) {
-                if (pp.rotation == RotationDirection::North || pp.rotation == RotationDirection::South) {
-                    // the piece is vertical, but it should be horizontal
-                    continue;
-                }
-            }
+    std::optional<EarliestPC> earliest_pc(const Board& board, const Queue& queue, Rules::Id rules) {
+        return Rules::visit(rules, [&]<typename R>() { return earliest_pc_search<R>(board, queue); });
+    }
 
-            if (T_should_be_vertical && pp.type == PieceType::T) {
-                if (pp.rotation == RotationDirection::East || pp.rotation == RotationDirection::West) {
-                    // the piece is horizontal, but it should be vertical
-                    continue;
-                }
-            }
+    // the number of pc paths below every state the count search has finished, shared by its threads
+    class PathCounts {
+    public:
+        std::optional<uint64_t> find(const NodeKey& key) {
+            return counts.with(key, [&](auto& shard) -> std::optional<uint64_t> {
+                auto it = shard.find(key);
+                if (it == shard.end())
+                    return std::nullopt;
+                return it->second;
+            });
+        }
 
-            // we havent pc'd yet and we have more pieces to use
-            // recurse
-            solve_pcs_recurse(
-                {.game = new_game,
-                .queue = state.queue,
-                .path = state.path,
-                .solutions = state.solutions,
-                .pieces_used = pieces_used,
-                .cleared_lines = state.cleared_lines + lines_cleared,
-                .max_lines = state.max_lines});
+        void insert(const NodeKey& key, uint64_t paths) {
+            counts.with(key, [&](auto& shard) { shard.emplace(key, paths); });
         }
 
+    private:
+        ShardedMap<NodeKey, uint64_t, NodeKeyHash, NodeKeyEqual> counts;
+    };
+
+    struct count_pcs_state {
+        const Game& game;
+        const Queue& queue;
+        PathCounts& counts;
+        // pieces used thus far in the queue
+        const int pieces_used;
+        // lines cleared thus far
+        const int cleared_lines;
+        // the number of lines that we are constraining the pc to happen in
+        const int max_lines;
+        // this thread's view of the search limits
+        Ticker& ticker;
+    };
+
+    template <typename R>
+    static uint64_t count_pcs_recurse(const count_pcs_state& state);
+
+    // the pc paths through the state right after a piece was placed, counted the way solve_pcs_child finds them
+    template <typename R>
+    static uint64_t count_pcs_child(const count_pcs_state& parent, const Game& new_game, int lines_cleared, int pieces_used) {
+        if (parent.cleared_lines + lines_cleared == parent.max_lines || !new_game.board.any())
+            return 1;
+
+        if (pieces_used == parent.queue.size())
+            return 0;
+
+        return count_pcs_recurse<R>({
+            .game = new_game,
+            .queue = parent.queue,
+            .counts = parent.counts,
+            .pieces_used = pieces_used,
+            .cleared_lines = parent.cleared_lines + lines_cleared,
+            .max_lines = parent.max_lines,
+            .ticker = parent.ticker});
     }
-    */
 
+    template <typename R>
+    static uint64_t count_pcs_recurse(const count_pcs_state& state) {
+        if (state.ticker.expired())
+            return 0;
 
-    std::vector<std::vector<FullPiece>> solve_pcs(const Board& board, const Queue& queue) {
-        return {};
+        Game game = state.game;
+
+        // copy the queue
+        for (size_t i = 0; i < QUEUE_SIZE && i + state.pieces_used + 1 < state.queue.size(); i++) {
+            game.queue.at(i) = state.queue.at(i + state.pieces_used + 1);
+        }
+
+        // the board and pieces used also fix the lines cleared, so this is the whole state
+        const NodeKey key{.board = game.board, .current = game.current_piece, .hold = game.hold, .pieces_used = state.pieces_used};
+        if (auto known = state.counts.find(key); known.has_value())
+            return *known;
+
+        uint64_t paths = 0;
+        for_each_child<R>(game, state.pieces_used, state.max_lines - state.cleared_lines,
+            [&](const FullPiece&, const Game& new_game, int lines_cleared, int pieces_used) {
+                paths += count_pcs_child<R>(state, new_game, lines_cleared, pieces_used);
+                return state.ticker.watchdog.expired();
+            });
+
+        // a search cut short counted too few paths, which must not be handed to anyone else
+        if (!state.ticker.watchdog.expired())
+            state.counts.insert(key, paths);
+        return paths;
     }
-    // returns the Moves for every PC possible
-    /*
-    std::vector<std::vector<FullPiece>> solve_pcs(const Board& board, const Queue& queue) {
-        std::vector<std::vector<FullPiece>> solutions;
+
+    template <typename R>
+    static CountResult count_pcs_search(const Board& board, const Queue& queue, const SearchLimits& limits) {
+        Watchdog watchdog(limits);
+        if (queue.empty())
+            return {.search = watchdog.finish(Status::Unsolvable, 0)};
 
         Game game;
+        game.board = board;
         game.current_piece = queue[0];
-
-        for (size_t i = 0;  i < QUEUE_SIZE  &&  i + 1 < queue.size(); i++) {
-            game.queue[i] = queue[i+1];
+        game.queue.fill(PieceType::Empty);
+        for (size_t i = 1; i < QUEUE_SIZE && i < queue.size(); i++) {
+            game.queue[i - 1] = queue[i];
         }
+        const int max_lines = PC_HEIGHT;
 
-        game.board = board;
+        PathCounts counts;
+        std::atomic<uint64_t> paths = 0;
+        std::deque<Ticker> tickers;
 
-        auto ppp = game.current_piece_movegen();
-        auto pppp = game.hold_piece_movegen();
-        int max_lines = 4;
+        #ifdef MULTITHREADED
+        std::vector<std::jthread> threads;
+        #endif
 
-        std::atomic_bool solved = false;
+        for_each_child<R>(game, 0, max_lines, [&](const FullPiece&, const Game& new_game, int lines_cleared, int pieces_used) {
+            #ifndef MULTITHREADED
+            if (watchdog.expired())
+                return true;
+            #endif
 
-        std::vector<std::jthread> threads(ppp.size());
-        std::vector<std::vector<std::vector<FullPiece>>> return_values(ppp.size());
+            Ticker& ticker = tickers.emplace_back(watchdog);
+            auto search = [&queue, &counts, &paths, &ticker, new_game, lines_cleared, pieces_used, max_lines]() {
+                paths.fetch_add(count_pcs_child<R>({
+                    .game = new_game,
+                    .queue = queue,
+                    .counts = counts,
+                    .pieces_used = 0,
+                    .cleared_lines = 0,
+                    .max_lines = max_lines,
+                    .ticker = ticker}, new_game, lines_cleared, pieces_used), std::memory_order_relaxed);
+            };
+            #ifdef MULTITHREADED
+            threads.emplace_back(search);
+            #else
+            search();
+            #endif
+            return false;
+        });
 
-        int i = 0;
-        for (auto& pp : ppp) {
-            threads[i] = std::jthread([game, queue, pp, &solved, max_lines, &return_value = return_values[i]]() {
-                Game new_game = game;
+        #ifdef MULTITHREADED
+        threads.clear();
+        #endif
 
-                // make sure the piece is valid
-                bool valid = true;
-                for (auto& mino : pp.minos) {
-                    if (pp.position.y + mino.y >= (max_lines - 0)) { // 0 => cleared lines
-                        valid = false;
-                    }
-                }
+        uint64_t nodes = 0;
+        for (const Ticker& ticker : tickers)
+            nodes += ticker.nodes;
 
-                if (!valid) {
-                    return;
-                }
+        CountResult result{.paths = paths.load()};
+        if (watchdog.expired())
+            result.search = watchdog.finish(Status::TimedOut, nodes);
+        else
+            result.search = watchdog.finish(result.paths == 0 ? Status::Unsolvable : Status::Solved, nodes);
+        return result;
+    }
+
+    CountResult count_pcs(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules) {
+        return Rules::visit(rules, [&]<typename R>() { return count_pcs_search<R>(board, queue, limits); });
+    }
+
+    struct pc_then_state {
+        const Game& game;
+        const Queue& queue;
+        // nodes already shown to have no pc that accept takes
+        std::unordered_set<NodeKey, NodeKeyHash, NodeKeyEqual>& dead;
+        const std::function<bool(const Queue&)>& accept;
+        // pieces used thus far in the queue
+        const int pieces_used;
+        // lines cleared thus far
+        const int cleared_lines;
+        // the number of lines that we are constraining the pc to happen in
+        const int max_lines;
+        // this search's view of the search limits
+        Ticker& ticker;
+        // the dead state cache and move order
+        const SearchOptions& options;
+    };
 
-                bool held_first = new_game.place_piece(pp);
-                int lines_cleared = new_game.board.clearLines();
+    // what a pc leaves for the next one, see can_pc_then
+    static Queue leftover_queue(const Game& game, const Queue& queue, int pieces_used) {
+        Queue leftover;
+        if (game.hold.has_value() && *game.hold != PieceType::Empty)
+            leftover.push_back(*game.hold);
+        leftover.insert(leftover.end(), queue.begin() + pieces_used, queue.end());
+        return leftover;
+    }
 
+    template <typename R>
+    static bool pc_then_recurse(const pc_then_state& state) {
+        if (state.ticker.expired())
+            return false;
 
+        Game game = state.game;
 
-                if (lines_cleared == max_lines) {
-                    solved = true;
-                    return_value = {{pp}};
-                    return;
-                }
-                int pieces_used = 1;
+        // copy the queue
+        for (size_t i = 0; i < QUEUE_SIZE && i + state.pieces_used + 1 < state.queue.size(); i++) {
+            game.queue.at(i) = state.queue.at(i + state.pieces_used + 1);
+        }
 
-                if (held_first) {
-                    pieces_used++;
+        // a pc clears every line up to the top of the stack, leftovers on the empty board are often too short for that
+        const auto rows = board_rows(game.board);
+        int stack_height = 0;
+        for (int y = 0; y < (int)Board::height; ++y)
+            if (rows[y] != 0)
+                stack_height = y + 1;
+        const int placeable = int(state.queue.size()) - state.pieces_used + (game.hold.has_value() && *game.hold != PieceType::Empty);
+        if (game.empty_cells(stack_height) > placeable * 4)
+            return false;
+
+        // unlike can_pc this keeps going past pcs accept turns down, so states are worth remembering even without the cache
+        // what a pc below a state leaves over only depends on the state, so a state that failed once always fails
+        const NodeKey key{.board = game.board, .current = game.current_piece, .hold = game.hold, .pieces_used = state.pieces_used};
+        if (state.dead.contains(key))
+            return false;
+
+        // the same as can_pc, no pc at all is the strongest kind of dead
+        const int lines_left = state.max_lines - state.cleared_lines;
+        if (NogoodCache* nogoods = state.options.nogoods; nogoods != nullptr) {
+            auto pieces = pieces_left(game, state.queue, state.pieces_used);
+            if (pieces.has_value() && nogoods->dead(game.board, lines_left, *pieces))
+                return false;
+        }
+
+        bool found = false;
+        for_each_child_in_order<R>(game, state.pieces_used, lines_left, state.options.order,
+            [&](const FullPiece&, const Game& new_game, int lines_cleared, int pieces_used) {
+                if (state.cleared_lines + lines_cleared == state.max_lines || !new_game.board.any()) {
+                    found = state.accept(leftover_queue(new_game, state.queue, pieces_used));
+                    return found || state.ticker.watchdog.expired();
                 }
-                std::vector<FullPiece> path{pp};
-                solve_pcs_recurse(
-                    {.game = new_game,
-                    .queue = queue,
-                    .path = path,
-                    .solutions = return_value,
+
+                if (pieces_used == state.queue.size())
+                    return false;
+
+                found = pc_then_recurse<R>({
+                    .game = new_game,
+                    .queue = state.queue,
+                    .dead = state.dead,
+                    .accept = state.accept,
                     .pieces_used = pieces_used,
-                    .cleared_lines = lines_cleared,
-                    .max_lines = max_lines});
-                return;
+                    .cleared_lines = state.cleared_lines + lines_cleared,
+                    .max_lines = state.max_lines,
+                    .ticker = state.ticker,
+                    .options = state.options});
+                return found || state.ticker.watchdog.expired();
             });
 
-            ++i;
-        }
+        // a search cut short did not see every pc below the state
+        if (!found && !state.ticker.watchdog.expired())
+            state.dead.insert(key);
+        return found;
+    }
 
-        for (auto& thread : threads) {
-            thread.join();
-        }
+    template <typename R>
+    static SearchResult can_pc_then_search(const Board& board, const Queue& queue, const SearchLimits& limits,
+            const SearchOptions& options, const std::function<bool(const Queue&)>& accept) {
+        Watchdog watchdog(limits);
+        if (queue.empty())
+            return watchdog.finish(Status::Unsolvable, 0);
 
-        for (const auto& return_value : return_values) {
-            for (const auto &solution : return_value) {
-                solutions.push_back(solution);
-            }
+        Game game;
+        game.board = board;
+        game.current_piece = queue[0];
+        game.queue.fill(PieceType::Empty);
+        for (size_t i = 1; i < QUEUE_SIZE && i < queue.size(); i++) {
+            game.queue[i - 1] = queue[i];
         }
 
-        return solutions;
+        // accept can start searches of its own, so this one stays on the calling thread
+        std::unordered_set<NodeKey, NodeKeyHash, NodeKeyEqual> dead;
+        Ticker ticker(watchdog);
+        const bool found = pc_then_recurse<R>({
+            .game = game,
+            .queue = queue,
+            .dead = dead,
+            .accept = accept,
+            .pieces_used = 0,
+            .cleared_lines = 0,
+            .max_lines = PC_HEIGHT,
+            .ticker = ticker,
+            .options = options});
+
+        if (found)
+            return watchdog.finish(Status::Solved, ticker.nodes);
+        return watchdog.finish(watchdog.expired() ? Status::TimedOut : Status::Unsolvable, ticker.nodes);
+    }
+
+    SearchResult can_pc_then(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules,
+            const SearchOptions& options, const std::function<bool(const Queue& leftover)>& accept) {
+        return Rules::visit(rules, [&]<typename R>() { return can_pc_then_search<R>(board, queue, limits, options, accept); });
+    }
+
+    // returns the Moves for every distinct PC possible
+    std::vector<std::vector<FullPiece>> solve_pcs(const Board& board, const Queue& queue) {
+        std::vector<std::vector<FullPiece>> paths;
+        for (auto& solution : solve_unique_pcs(board, queue))
+            paths.push_back(std::move(solution.path));
+        return paths;
+    }
+
+    SolveResult solve_pcs(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules) {
+        return solve_unique_pcs(board, queue, limits, rules);
     }
-    */
-}  // namespace Solver
\ No newline at end of file
+}  // namespace Solver
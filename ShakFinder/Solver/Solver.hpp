@@ -1,13 +1,138 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <stop_token>
+#include <string_view>
+#include <variant>
 #include <vector>
 
+#include "Rules.hpp"
 #include "Util.hpp"
+#include "GameRules/jstris_score.hpp"
+#include "GameRules/tetrio.hpp"
 
 namespace Solver {
+    class NogoodCache;
+
+    // the number of lines every pc search is constrained to
+    constexpr int PC_HEIGHT = 4;
+
+    struct Solution {
+        // one placement order that reaches this pc
+        std::vector<FullPiece> path;
+        // how many placement orders (including hold choices) end with the same pieces in the same spots
+        size_t orderings = 0;
+    };
+
+    struct ScoredPath {
+        std::vector<FullPiece> path;
+        int score = 0;
+    };
+
+    struct EarliestPC {
+        std::vector<FullPiece> path;
+        // lines cleared by the pc
+        int lines = 0;
+    };
+
+    // the rules a pc path can be scored under, the search is instantiated per alternative
+    using Scorer = std::variant<tetrio_points, JstrisScore>;
+
+    // bounds on how long a single search may run
+    struct SearchLimits {
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        std::stop_token stop;
+    };
+
+    enum class Status {
+        Solved,
+        Unsolvable,
+        // the deadline passed or a stop was requested before the search finished
+        TimedOut,
+    };
+
+    // which placement can_pc tries first, it changes how soon a pc is found but never whether there is one
+    enum class MoveOrder : uint8_t {
+        // the order the movegen gives, rotation then column then row, current piece before hold
+        Natural,
+        // lowest cells first
+        Lowest,
+        // fewest empty cells left under filled ones, then lowest
+        FewestHoles,
+        // smallest difference between neighbouring column heights, then lowest
+        Flattest,
+    };
+
+    // natural, lowest, holes or flat
+    std::optional<MoveOrder> parse_move_order(std::string_view name);
+
+    // what can_pc can use besides the field, queue and rules
+    struct SearchOptions {
+        // dead states shared with other searches, see NogoodCache
+        NogoodCache* nogoods = nullptr;
+        MoveOrder order = MoveOrder::Natural;
+    };
+
+    struct SearchStats {
+        // nodes expanded, also counted for searches that were cut short
+        uint64_t nodes = 0;
+        double seconds = 0;
+    };
+
+    struct SearchResult {
+        Status status = Status::Unsolvable;
+        SearchStats stats;
+        // the path of the pc that was found, only set by can_pc
+        std::optional<std::vector<FullPiece>> witness;
+    };
+
+    struct SolveResult {
+        // the solutions found, possibly only some of them if the search timed out
+        std::vector<Solution> solutions;
+        SearchResult search;
+    };
+
+    struct CountResult {
+        // every placement order, hold choices included, that ends in a pc
+        // the same as adding up the orderings of every solution of solve_unique_pcs
+        uint64_t paths = 0;
+        SearchResult search;
+    };
+
+    // every search plays by the rules it is given, srs with hold unless told otherwise
+
     // returns whether or not a pc is possible
     bool can_pc(const Board& board, const Queue& queue);
+    SearchResult can_pc(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules = Rules::Id::Srs);
+    // the same with a dead state cache and move ordering, see SearchOptions
+    // what a NogoodCache holds is proven without the rules or the field it came from, so any searches can share one
+    SearchResult can_pc(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules, const SearchOptions& options);
+    // the same, but a pc only counts if accept takes what is left of the queue after it, for going on to another pc
+    // the leftover is the held piece, if there is one, followed by the pieces not used yet, which is the queue the next pc
+    // is searched with, since holding the first piece of a queue is the same as starting with it held
+    // accept runs on the searching thread and can be called with the same leftover more than once
+    SearchResult can_pc_then(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules,
+        const SearchOptions& options, const std::function<bool(const Queue& leftover)>& accept);
 
-    // returns the Moves for every PC possible
+    // returns the Moves for every distinct PC possible
     std::vector<std::vector<FullPiece>> solve_pcs(const Board& board, const Queue& queue);
-};
\ No newline at end of file
+    // same as solve_unique_pcs with limits, every distinct PC comes with one of its placement orders
+    SolveResult solve_pcs(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules = Rules::Id::Srs);
+
+    // returns every distinct PC possible, PCs that only differ in placement order are reported once
+    std::vector<Solution> solve_unique_pcs(const Board& board, const Queue& queue);
+    SolveResult solve_unique_pcs(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules = Rules::Id::Srs);
+
+    // counts the pc paths without keeping any of them, the paths below a state are counted once and reused
+    // every other time the search gets to that state
+    CountResult count_pcs(const Board& board, const Queue& queue, const SearchLimits& limits, Rules::Id rules = Rules::Id::Srs);
+
+    // returns the highest scoring PC under the scorer's rules, combo and b2b included
+    std::optional<ScoredPath> best_pc(const Board& board, const Queue& queue, const Scorer& scorer, Rules::Id rules = Rules::Id::Srs);
+
+    // returns the PC that uses the fewest pieces, which is also the one that clears the fewest lines
+    std::optional<EarliestPC> earliest_pc(const Board& board, const Queue& queue, Rules::Id rules = Rules::Id::Srs);
+};
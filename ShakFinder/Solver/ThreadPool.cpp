@@ -0,0 +1,61 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    workers.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i)
+        workers.emplace_back([this](std::stop_token stop) { work(stop); });
+}
+
+ThreadPool::~ThreadPool() {
+    for (auto& worker : workers)
+        worker.request_stop();
+    wake.notify_all();
+    workers.clear();
+}
+
+void ThreadPool::for_each_index(size_t count, const std::function<void(size_t)>& job) {
+    std::lock_guard batch(batch_mutex);
+    {
+        std::unique_lock lock(mutex);
+        // a worker that woke up late for the last batch may still be looking at it
+        finished.wait(lock, [this] { return busy == 0; });
+        this->job = &job;
+        this->count = count;
+        next = 0;
+        ++generation;
+    }
+    wake.notify_all();
+
+    run_batch();
+
+    std::unique_lock lock(mutex);
+    finished.wait(lock, [this] { return busy == 0; });
+}
+
+void ThreadPool::work(std::stop_token stop) {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            if (!wake.wait(lock, stop, [&] { return generation != seen; }))
+                return;
+            seen = generation;
+            ++busy;
+        }
+
+        run_batch();
+
+        std::lock_guard lock(mutex);
+        if (--busy == 0)
+            finished.notify_all();
+    }
+}
+
+void ThreadPool::run_batch() {
+    for (size_t i = next++; i < count; i = next++)
+        (*job)(i);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a fixed set of worker threads that get handed batches of indices
+// the thread calling for_each_index works on the batch too, so a pool of 1 runs everything on the caller
+class ThreadPool {
+public:
+    // 0 threads means one per core
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // threads working on a batch, the caller included
+    size_t size() const { return workers.size() + 1; }
+
+    // calls job(i) for every i below count spread over the pool and returns once every call finished
+    // job must not throw, batches from different threads run one after another
+    void for_each_index(size_t count, const std::function<void(size_t)>& job);
+
+private:
+    void work(std::stop_token stop);
+    void run_batch();
+
+    std::mutex batch_mutex;
+
+    std::mutex mutex;
+    std::condition_variable_any wake;
+    std::condition_variable finished;
+    // only changed while no worker is busy
+    const std::function<void(size_t)>* job = nullptr;
+    size_t count = 0;
+    std::atomic<size_t> next = 0;
+    size_t busy = 0;
+    uint64_t generation = 0;
+
+    std::vector<std::jthread> workers;
+};
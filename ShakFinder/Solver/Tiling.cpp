@@ -0,0 +1,397 @@
+#include "Tiling.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <unordered_set>
+#include <utility>
+
+namespace Solver {
+    static constexpr std::array<PieceType, 7> PIECES = { PieceType::I, PieceType::J, PieceType::L, PieceType::O, PieceType::S, PieceType::T, PieceType::Z };
+    static constexpr uint64_t FULL_ROW = (1 << Board::width) - 1;
+
+    using Cells = std::array<std::pair<int, int>, 4>;
+
+    // the minos of every piece and rotation, sorted so two placements can be lined up by their first cell
+    static const Cells& sorted_minos(PieceType piece, int rotation) {
+        static const auto table = [] {
+            std::array<std::array<Cells, 4>, 7> minos{};
+            for (size_t p = 0; p < PIECES.size(); ++p) {
+                for (int r = 0; r < 4; ++r) {
+                    auto cells = piece_cells({.type = PIECES[p], .x = 0, .y = 0, .r = (int8_t)r});
+                    std::sort(cells.begin(), cells.end());
+                    minos[p][r] = cells;
+                }
+            }
+            return minos;
+        }();
+        return table[std::find(PIECES.begin(), PIECES.end(), piece) - PIECES.begin()][rotation];
+    }
+
+    uint32_t add_piece(uint32_t key, PieceType piece) {
+        return key + (1u << (4 * (std::find(PIECES.begin(), PIECES.end(), piece) - PIECES.begin())));
+    }
+
+    static uint64_t row_bits(uint64_t cells, int y) {
+        return (cells >> (y * Board::width)) & FULL_ROW;
+    }
+
+    // rows that are completely filled
+    static uint32_t full_rows(uint64_t cells, int lines) {
+        uint32_t rows = 0;
+        for (int y = 0; y < lines; ++y)
+            if (row_bits(cells, y) == FULL_ROW)
+                rows |= 1 << y;
+        return rows;
+    }
+
+    // every placement of every piece inside the bottom lines, grouped by the lowest cell it covers
+    // a piece can be spread over rows with other rows between them, for when those were cleared before it went down
+    static std::vector<std::vector<Tile>> make_candidate_tiles(int lines) {
+        std::vector<std::vector<Tile>> by_cell(lines * Board::width);
+        std::unordered_set<uint64_t> seen[PIECES.size()];
+
+        for (size_t p = 0; p < PIECES.size(); ++p) {
+            for (int r = 0; r < 4; ++r) {
+                const Cells& minos = sorted_minos(PIECES[p], r);
+                int low = minos[0].second, high = minos[0].second;
+                for (const auto& [x, y] : minos) {
+                    low = std::min(low, y);
+                    high = std::max(high, y);
+                }
+                const int shape_rows = high - low + 1;
+
+                // which row every row of the piece ends up on
+                for (uint32_t rows = 0; rows < (1u << lines); ++rows) {
+                    if (std::popcount(rows) != shape_rows)
+                        continue;
+                    std::array<int, 4> row_of{};
+                    for (int i = 0, bits = rows; i < shape_rows; ++i, bits &= bits - 1)
+                        row_of[i] = std::countr_zero((uint32_t)bits);
+
+                    for (int x = -3; x < (int)Board::width + 3; ++x) {
+                        uint64_t cells = 0;
+                        bool inside = true;
+                        for (const auto& [dx, dy] : minos) {
+                            const int cx = x + dx;
+                            if (cx < 0 || cx >= (int)Board::width) {
+                                inside = false;
+                                break;
+                            }
+                            cells |= 1ULL << (row_of[dy - low] * Board::width + cx);
+                        }
+                        if (inside && seen[p].insert(cells).second)
+                            by_cell[std::countr_zero(cells)].push_back({.type = PIECES[p], .cells = cells});
+                    }
+                }
+            }
+        }
+        return by_cell;
+    }
+
+    // the same for every field, so they are only worked out once
+    static const std::vector<std::vector<Tile>>& candidate_tiles(int lines) {
+        static const auto by_lines = [] {
+            std::array<std::vector<std::vector<Tile>>, PC_HEIGHT + 1> by_lines;
+            for (int lines = 1; lines <= PC_HEIGHT; ++lines)
+                by_lines[lines] = make_candidate_tiles(lines);
+            return by_lines;
+        }();
+        return by_lines[lines];
+    }
+
+    static void enumerate_tilings(const std::vector<std::vector<Tile>>& candidates, uint64_t empty,
+        std::vector<Tile>& tiles, const std::function<void(const std::vector<Tile>&)>& found) {
+        if (empty == 0) {
+            found(tiles);
+            return;
+        }
+        // the lowest empty cell has to be covered by something, and nothing covering it goes any lower
+        for (const auto& tile : candidates[std::countr_zero(empty)]) {
+            if ((tile.cells & ~empty) != 0)
+                continue;
+            tiles.push_back(tile);
+            enumerate_tilings(candidates, empty & ~tile.cells, tiles, found);
+            tiles.pop_back();
+        }
+    }
+
+    TilingSolver::TilingSolver(const Board& board, Rules::Id rules) : rules(rules), order(board, rules) {
+        if (any_from_row(board, PC_HEIGHT)) {
+            fits = false;
+            return;
+        }
+
+        const auto rows = board_rows(board);
+        uint64_t field_cells = 0;
+        int stack_height = 0;
+        for (int y = 0; y < PC_HEIGHT; ++y) {
+            field_cells |= uint64_t(rows[y]) << (y * Board::width);
+            if (rows[y] != 0)
+                stack_height = y + 1;
+        }
+        const int filled = board.popcount();
+
+        // smaller heights are the pcs that empty the board before all the lines are used
+        for (int lines = std::max(stack_height, 1); lines <= PC_HEIGHT; ++lines) {
+            const int empty = lines * (int)Board::width - filled;
+            if (empty <= 0 || empty % 4 != 0)
+                continue;
+
+            Height& height = heights.emplace_back();
+            height.lines = lines;
+            height.pieces = empty / 4;
+
+            const uint64_t region = (1ULL << (lines * Board::width)) - 1;
+            std::vector<Tile> tiles;
+            enumerate_tilings(candidate_tiles(lines), region & ~field_cells, tiles, [&](const std::vector<Tile>& tiling) {
+                height.by_pieces[pieces_key(tiling)].push_back({tiling});
+            });
+        }
+    }
+
+    uint32_t pieces_key(const std::vector<Tile>& tiles) {
+        uint32_t key = 0;
+        for (const Tile& tile : tiles)
+            key = add_piece(key, tile.type);
+        return key;
+    }
+
+    std::vector<uint32_t> queue_keys(const Queue& queue, size_t n, bool can_hold) {
+        std::vector<uint32_t> keys;
+        if (queue.size() < n)
+            return keys;
+        uint32_t first = 0;
+        for (size_t i = 0; i < n; ++i)
+            first = add_piece(first, queue[i]);
+        keys.push_back(first);
+        if (can_hold && queue.size() > n) {
+            const uint32_t all = add_piece(first, queue[n]);
+            for (size_t i = 0; i <= n; ++i)
+                keys.push_back(all - add_piece(0, queue[i]));
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        return keys;
+    }
+
+    static uint64_t field_bits(const Board& board) {
+        const auto rows = board_rows(board);
+        uint64_t cells = 0;
+        for (int y = 0; y < PC_HEIGHT; ++y)
+            cells |= uint64_t(rows[y]) << (y * Board::width);
+        return cells;
+    }
+
+    PlacementOrder::PlacementOrder(const Board& board, Rules::Id rules) : field_cells(field_bits(board)), rules(rules), movegen(rules) {
+        can_hold = Rules::visit(rules, []<typename R>() { return R::hold; });
+    }
+
+    // where a tile goes in the board as it is once the tiles in occupied are down, if it can get there
+    std::optional<FullPiece> PlacementOrder::locate(const Tile& tile, uint64_t occupied) {
+        const uint32_t full = full_rows(occupied, PC_HEIGHT);
+        uint32_t tile_rows = 0;
+        for (int y = 0; y < PC_HEIGHT; ++y)
+            if (row_bits(tile.cells, y) != 0)
+                tile_rows |= 1 << y;
+
+        // every row between the tile's own rows has to be cleared already
+        const int low = std::countr_zero(tile_rows), high = 31 - std::countl_zero(tile_rows);
+        for (int y = low + 1; y < high; ++y)
+            if (!(tile_rows >> y & 1) && !(full >> y & 1))
+                return std::nullopt;
+
+        Board board;
+        for (uint64_t bits = occupied; bits != 0; bits &= bits - 1) {
+            const int cell = std::countr_zero(bits);
+            board.set(cell % Board::width, cell / Board::width);
+        }
+        board.clear_full_lines();
+
+        Cells cells{};
+        int i = 0;
+        for (uint64_t bits = tile.cells; bits != 0; bits &= bits - 1, ++i) {
+            const int cell = std::countr_zero(bits);
+            const int y = cell / Board::width;
+            cells[i] = {cell % Board::width, y - std::popcount(full & ((1u << y) - 1))};
+        }
+        std::sort(cells.begin(), cells.end());
+
+        const Moves& reachable = movegen.moves(board, tile.type);
+        for (int r = 0; r < (int)reachable.size(); ++r) {
+            const Cells& minos = sorted_minos(tile.type, r);
+            const int x = cells[0].first - minos[0].first;
+            const int y = cells[0].second - minos[0].second;
+            bool same = true;
+            for (int m = 1; m < 4; ++m)
+                same &= cells[m].first == x + minos[m].first && cells[m].second == y + minos[m].second;
+            if (same && x >= 0 && x < (int)Board::width && y >= 0 && y < (int)Board::height && cell_filled(reachable[r], x, y))
+                return FullPiece{.type = tile.type, .x = (int8_t)x, .y = (int8_t)y, .r = (int8_t)r};
+        }
+        return std::nullopt;
+    }
+
+    bool PlacementOrder::find(const std::vector<Tile>& tiles, const Queue& queue, std::vector<FullPiece>& path, uint64_t& nodes) {
+        const uint32_t all_placed = (1u << tiles.size()) - 1;
+
+        // states already shown to go nowhere, keyed by the tiles placed, the queue position and the hold piece
+        std::unordered_set<uint64_t> dead;
+
+        auto search = [&](auto& self, uint32_t placed, uint64_t occupied, size_t next, PieceType held) -> bool {
+            if (placed == all_placed)
+                return true;
+            const uint64_t key = uint64_t(placed) | uint64_t(next) << 32 | uint64_t(held) << 48;
+            if (dead.contains(key))
+                return false;
+            nodes++;
+
+            // the piece that goes down, and the queue position and hold piece after it
+            struct Option {
+                PieceType piece;
+                size_t next;
+                PieceType held;
+            };
+            std::array<Option, 2> options;
+            int option_count = 0;
+            if (next < queue.size())
+                options[option_count++] = {queue[next], next + 1, held};
+            if (can_hold) {
+                if (held != PieceType::Empty && next < queue.size() && held != queue[next])
+                    options[option_count++] = {held, next + 1, queue[next]};
+                else if (held == PieceType::Empty && next + 1 < queue.size())
+                    options[option_count++] = {queue[next + 1], next + 2, queue[next]};
+            }
+
+            for (int o = 0; o < option_count; ++o) {
+                const Option& option = options[o];
+                for (size_t t = 0; t < tiles.size(); ++t) {
+                    const Tile& tile = tiles[t];
+                    if ((placed >> t & 1) || tile.type != option.piece)
+                        continue;
+                    auto piece = locate(tile, occupied);
+                    if (!piece.has_value())
+                        continue;
+                    path.push_back(*piece);
+                    if (self(self, placed | 1u << t, occupied | tile.cells, option.next, option.held))
+                        return true;
+                    path.pop_back();
+                }
+            }
+            dead.insert(key);
+            return false;
+        };
+
+        path.clear();
+        return search(search, 0, field_cells, 0, PieceType::Empty);
+    }
+
+    std::optional<std::vector<Tile>> PlacementOrder::tiles(const std::vector<FullPiece>& path) const {
+        // the rows of the starting board that are still there, bottom first
+        std::vector<int> rows;
+        for (int y = 0; y < PC_HEIGHT; ++y)
+            rows.push_back(y);
+
+        std::vector<Tile> tiles;
+        uint64_t occupied = field_cells;
+        for (const FullPiece& piece : path) {
+            Tile tile{.type = piece.type};
+            for (const auto& [x, y] : piece_cells(piece)) {
+                if (y < 0 || y >= (int)rows.size())
+                    return std::nullopt;
+                tile.cells |= 1ULL << (rows[y] * Board::width + x);
+            }
+            occupied |= tile.cells;
+            tiles.push_back(tile);
+            std::erase_if(rows, [&](int y) { return row_bits(occupied, y) == FULL_ROW; });
+        }
+        return tiles;
+    }
+
+    // fills empty from its lowest cell with pieces left in the key, stopping at the first way that works
+    static bool fill(const std::vector<std::vector<Tile>>& candidates, uint64_t empty, uint32_t pieces) {
+        if (empty == 0)
+            return true;
+        for (const auto& tile : candidates[std::countr_zero(empty)]) {
+            if ((tile.cells & ~empty) != 0)
+                continue;
+            const uint32_t one = add_piece(0, tile.type);
+            // no borrow out of the 4 bits of this piece type
+            if ((pieces & (one * 15)) == 0)
+                continue;
+            if (fill(candidates, empty & ~tile.cells, pieces - one))
+                return true;
+        }
+        return false;
+    }
+
+    bool can_fill(const Board& board, int lines_left, uint32_t pieces) {
+        if (lines_left <= 0 || lines_left > PC_HEIGHT || any_from_row(board, lines_left))
+            return true;
+
+        const uint64_t field_cells = field_bits(board);
+        const int filled = board.popcount();
+        int stack_height = 0;
+        for (int y = 0; y < lines_left; ++y)
+            if (row_bits(field_cells, y) != 0)
+                stack_height = y + 1;
+
+        int piece_count = 0;
+        for (size_t p = 0; p < PIECES.size(); ++p)
+            piece_count += (pieces >> (4 * p)) & 15;
+
+        // a pc can also empty the board before all of the lines are used
+        for (int lines = std::max(stack_height, 1); lines <= lines_left; ++lines) {
+            const int empty = lines * (int)Board::width - filled;
+            if (empty <= 0 || empty % 4 != 0 || empty / 4 > piece_count)
+                continue;
+            const uint64_t region = (1ULL << (lines * Board::width)) - 1;
+            if (fill(candidate_tiles(lines), region & ~field_cells, pieces))
+                return true;
+        }
+        return false;
+    }
+
+    size_t TilingSolver::tiling_count() const {
+        size_t count = 0;
+        for (const Height& height : heights)
+            for (const auto& [key, tilings] : height.by_pieces)
+                count += tilings.size();
+        return count;
+    }
+
+    SearchResult TilingSolver::can_pc(const Queue& queue, const SearchLimits& limits) {
+        const auto start = std::chrono::steady_clock::now();
+        const bool can_hold = Rules::visit(rules, []<typename R>() { return R::hold; });
+
+        SearchResult result;
+        auto finish = [&](Status status) {
+            result.status = status;
+            result.stats.seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1e9;
+            return result;
+        };
+
+        std::vector<FullPiece> path;
+        size_t checked = 0;
+        for (const Height& height : heights) {
+            for (uint32_t key : queue_keys(queue, height.pieces, can_hold)) {
+                auto it = height.by_pieces.find(key);
+                if (it == height.by_pieces.end())
+                    continue;
+                for (const Tiling& tiling : it->second) {
+                    if (limits.stop.stop_requested() ||
+                        (limits.deadline.has_value() && ++checked % 16 == 0 && std::chrono::steady_clock::now() >= *limits.deadline))
+                        return finish(Status::TimedOut);
+
+                    if (order.find(tiling.tiles, queue, path, result.stats.nodes)) {
+                        result.witness = path;
+                        return finish(Status::Solved);
+                    }
+                }
+            }
+        }
+        return finish(Status::Unsolvable);
+    }
+}
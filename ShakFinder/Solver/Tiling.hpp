@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "Movegen.hpp"
+#include "Rules.hpp"
+#include "Solver.hpp"
+#include "Util.hpp"
+
+namespace Solver {
+    // a piece of a tiling, cells are bits y * 10 + x in the coordinates of the starting board
+    // a piece can have rows of other pieces between its own, those have to be cleared before it goes down
+    struct Tile {
+        PieceType type;
+        uint64_t cells = 0;
+    };
+
+    // finds an order a queue can put a set of tiles down in, with hold if the rules have it
+    // a tile can only go down once the movegen of the board at that point reaches it
+    class PlacementOrder {
+    public:
+        PlacementOrder(const Board& board, Rules::Id rules);
+
+        // fills path with the pieces in the order they go down, in the coordinates of the board at that point
+        bool find(const std::vector<Tile>& tiles, const Queue& queue, std::vector<FullPiece>& path, uint64_t& nodes);
+
+        // the tiles of a path found by any of the solvers, nullopt if it goes above PC_HEIGHT
+        std::optional<std::vector<Tile>> tiles(const std::vector<FullPiece>& path) const;
+
+    private:
+        std::optional<FullPiece> locate(const Tile& tile, uint64_t occupied);
+
+        uint64_t field_cells = 0;
+        Rules::Id rules;
+        bool can_hold;
+
+        // the boards seen so far, a solver keeps them for all the queues it is asked about up to the cache's limit
+        MovegenCache movegen;
+    };
+
+    // one more of piece in a key of piece counts, 4 bits per piece type
+    uint32_t add_piece(uint32_t key, PieceType piece);
+    // the pieces a set of tiles uses, 4 bits per piece type
+    uint32_t pieces_key(const std::vector<Tile>& tiles);
+    // the keys of the piece sets a queue can put down n of, the first n or with hold the first n + 1 but one
+    std::vector<uint32_t> queue_keys(const Queue& queue, size_t n, bool can_hold);
+
+    // whether some of the pieces in the key could fill the empty cells of the bottom lines_left lines, or of fewer lines
+    // for a pc that empties the board early, ignoring the order they come in and whether they can get there
+    // false is a proof that no queue with these pieces has a pc, true proves nothing
+    bool can_fill(const Board& board, int lines_left, uint32_t pieces);
+
+    // a second engine for running many queues on one field, in the style of solution-finder
+    // every way to fill the empty part of the bottom lines with tetrominoes is worked out once when it is built,
+    // after that a queue only has to find a tiling whose pieces it can put down in some order, with hold
+    // a solver is for one thread, it keeps the movegen of the boards it has seen up to the limit of a MovegenCache
+    class TilingSolver {
+    public:
+        TilingSolver(const Board& board, Rules::Id rules = Rules::Id::Srs);
+
+        // false for fields with cells at or above PC_HEIGHT, which only the normal search handles
+        bool applicable() const { return fits; }
+
+        // the same answer as Solver::can_pc, the deadline is checked between tilings
+        SearchResult can_pc(const Queue& queue, const SearchLimits& limits = {});
+
+        size_t tiling_count() const;
+
+    private:
+        struct Tiling {
+            std::vector<Tile> tiles;
+        };
+        // tilings of one pc height, grouped by the pieces they use
+        struct Height {
+            int lines = 0;
+            int pieces = 0;
+            std::unordered_map<uint32_t, std::vector<Tiling>> by_pieces;
+        };
+
+        Rules::Id rules;
+        bool fits = true;
+        std::vector<Height> heights;
+        PlacementOrder order;
+    };
+};
@@ -1,6 +1,15 @@
 #pragma once
 
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include <search.hpp>
@@ -8,6 +17,8 @@
 #include "block.hpp"
 #include "utils.hpp"
 
+#include "Rules.hpp"
+
 enum PieceType : uint8_t {
     S = 'S',
     Z = 'Z',
@@ -35,30 +46,446 @@ struct FullPiece {
     int8_t y = 20;
     int8_t r = 0;
 };
+
+// the board cells a piece covers when placed
+inline std::array<std::pair<int, int>, 4> piece_cells(const FullPiece& piece) {
+    std::array<std::pair<int, int>, 4> cells{};
+    reachability::blocks::call_with_block<reachability::blocks::SRS>(piece.type, [&]<reachability::block B>(){
+        reachability::static_for<B.BLOCK_PER_MINO>([&](const std::size_t mino_i) {
+            cells[mino_i] = {piece.x + B.minos[B.mino_index[piece.r]][mino_i][0],
+                             piece.y + B.minos[B.mino_index[piece.r]][mino_i][1]};
+        });
+    });
+    return cells;
+}
 constexpr auto QUEUE_SIZE = 5;
+// ceilings up to this get a movegen that spawns right above them, anything higher uses the normal spawn
+constexpr auto MAX_LOW_SPAWN_CEILING = 6;
 using Board = reachability::board_t<10,24>;
+
+// the board stores each column as a run of Board::height bits, with 64 / Board::height columns packed into every word
+constexpr int COLUMNS_PER_WORD = 64 / Board::height;
+// the helpers below read Board::data with that layout directly, nothing in the library's interface promises it
+static_assert(sizeof(Board::data) == sizeof(uint64_t) * ((Board::width + COLUMNS_PER_WORD - 1) / COLUMNS_PER_WORD),
+              "Board::data no longer has COLUMNS_PER_WORD columns per word");
+
+// the bits of one board word that are below max_row
+inline uint64_t rows_mask(int max_row) {
+    max_row = std::clamp(max_row, 0, (int)Board::height);
+    uint64_t mask = 0;
+    for (int column = 0; column < COLUMNS_PER_WORD; ++column)
+        mask |= ((1ULL << max_row) - 1) << (column * Board::height);
+    return mask;
+}
+
+// clears every cell at or above max_row
+inline void clear_rows_from(Board& board, int max_row) {
+    const uint64_t mask = rows_mask(max_row);
+    for (auto& word : board.data)
+        word &= mask;
+}
+
+// whether anything is filled at or above row
+inline bool any_from_row(const Board& board, int row) {
+    const uint64_t mask = rows_mask(row);
+    for (auto word : board.data)
+        if ((word & ~mask) != 0)
+            return true;
+    return false;
+}
+
+// calls f(x, y) for every filled cell below max_row, stopping early once f returns true
+// only the set bits are visited
+template <typename F>
+inline bool for_each_set_cell(const Board& board, int max_row, F&& f) {
+    if (max_row <= 0)
+        return false;
+
+    const uint64_t mask = rows_mask(max_row);
+    for (size_t word = 0; word < board.data.size(); ++word) {
+        uint64_t bits = board.data[word] & mask;
+        while (bits != 0) {
+            const int bit = std::countr_zero(bits);
+            bits &= bits - 1;
+            if (f(int(word * COLUMNS_PER_WORD + bit / Board::height), int(bit % Board::height)))
+                return true;
+        }
+    }
+    return false;
+}
+
+// whether the cell at (x, y) is filled
+inline bool cell_filled(const Board& board, int x, int y) {
+    const uint64_t word = board.data[x / COLUMNS_PER_WORD];
+    return (word >> ((x % COLUMNS_PER_WORD) * Board::height + y) & 1) != 0;
+}
+
+template <int x, int y>
+inline bool board_cell_matches() {
+    Board board{};
+    board.data[x / COLUMNS_PER_WORD] |= 1ULL << ((x % COLUMNS_PER_WORD) * Board::height + y);
+    return board.template get<x, y>();
+}
+
+template <size_t... cells>
+inline bool board_layout_matches(std::index_sequence<cells...>) {
+    return (board_cell_matches<int(cells % Board::width), int(cells / Board::width)>() && ...);
+}
+
+// whether the bit the helpers above use for every (x, y) is the cell the library's get<x, y> reads
+// the static_assert only catches a change in the word count, this catches the columns moving around inside them
+inline bool board_layout_matches() {
+    return board_layout_matches(std::make_index_sequence<Board::width * Board::height>{});
+}
+
+// the cells of column x as a bitmask of its filled rows, bit y
+inline uint32_t column_bits(const Board& board, int x) {
+    const uint64_t word = board.data[x / COLUMNS_PER_WORD];
+    return uint32_t(word >> ((x % COLUMNS_PER_WORD) * Board::height)) & ((1u << Board::height) - 1);
+}
+
+// every row of the board as a bitmask of its filled columns
+inline std::array<uint16_t, Board::height> board_rows(const Board& board) {
+    std::array<uint16_t, Board::height> rows{};
+    for_each_set_cell(board, Board::height, [&](int x, int y) {
+        rows[y] |= 1 << x;
+        return false;
+    });
+    return rows;
+}
+
+// the board moved right by dx columns and up by dy rows, cells pushed off the board are dropped
+inline Board shift_board(const Board& board, int dx, int dy) {
+    Board shifted{};
+    const uint32_t column_mask = (1u << Board::height) - 1;
+    for (int x = std::max(0, -dx); x < (int)Board::width && x + dx < (int)Board::width; ++x) {
+        const uint32_t column = column_bits(board, x);
+        const uint32_t moved = (dy >= 0 ? column << dy : column >> -dy) & column_mask;
+        const int to = x + dx;
+        shifted.data[to / COLUMNS_PER_WORD] |= uint64_t(moved) << ((to % COLUMNS_PER_WORD) * Board::height);
+    }
+    return shifted;
+}
+
+// a rotation that covers the same cells as an earlier one, like the two flat states of s, z and i or every state of o
+// the placement at (x, y) in it is the placement at (x + dx, y + dy) in rotation twin, twin is -1 for a shape of its own
+struct RotationTwin {
+    int twin = -1;
+    int dx = 0;
+    int dy = 0;
+};
+
+template <reachability::block B>
+consteval std::array<RotationTwin, 4> rotation_twins() {
+    // every rotation's minos sorted, so two rotations with the same shape line up mino for mino
+    std::array<std::array<std::pair<int, int>, 4>, 4> shapes{};
+    for (std::size_t r = 0; r < 4; ++r) {
+        for (std::size_t i = 0; i < 4; ++i)
+            shapes[r][i] = {B.minos[B.mino_index[r]][i][0], B.minos[B.mino_index[r]][i][1]};
+        std::ranges::sort(shapes[r]);
+    }
+
+    std::array<RotationTwin, 4> twins{};
+    for (std::size_t r = 1; r < 4; ++r) {
+        for (std::size_t earlier = 0; earlier < r && twins[r].twin < 0; ++earlier) {
+            const int dx = shapes[r][0].first - shapes[earlier][0].first;
+            const int dy = shapes[r][0].second - shapes[earlier][0].second;
+            bool same = true;
+            for (std::size_t i = 0; i < 4; ++i)
+                same = same && shapes[r][i].first - dx == shapes[earlier][i].first && shapes[r][i].second - dy == shapes[earlier][i].second;
+            // a twin of a twin points at the first rotation with that shape
+            if (same && twins[earlier].twin < 0)
+                twins[r] = {.twin = int(earlier), .dx = dx, .dy = dy};
+        }
+    }
+    return twins;
+}
+
+// drops every placement that covers the same cells as a placement of an earlier rotation in moves
+// so each footprint is only left once, under the first rotation that reaches it
+// a rotation's placements that only it reaches, like spins into a spot the twin can't get to, are kept
+inline void drop_rotation_twins(reachability::static_vector<Board, 4UL>& moves, PieceType piece) {
+    reachability::blocks::call_with_block<reachability::blocks::SRS>((char)piece, [&]<reachability::block B>() {
+        constexpr auto twins = rotation_twins<B>();
+        for (std::size_t rot = 1; rot < moves.size(); ++rot) {
+            if (twins[rot].twin < 0 || twins[rot].twin >= (int)moves.size())
+                continue;
+            const Board covered = shift_board(moves[twins[rot].twin], -twins[rot].dx, -twins[rot].dy);
+            for (std::size_t word = 0; word < covered.data.size(); ++word)
+                moves[rot].data[word] &= ~covered.data[word];
+        }
+    });
+}
+
+// hashes and compares the raw bits of a board, for using boards as hash map keys
+struct BoardHash {
+    size_t operator()(const Board& board) const noexcept {
+        return std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(&board), sizeof(Board)));
+    }
+};
+struct BoardEqual {
+    bool operator()(const Board& a, const Board& b) const noexcept {
+        return std::memcmp(&a, &b, sizeof(Board)) == 0;
+    }
+};
+
+// offsets of the guideline srs description, per rotation and kick test, for pieces in true rotation about (0, 0)
+// kicking from one rotation to another tries offset[from][i] - offset[to][i] in order
+constexpr int SRS_OFFSETS[4][5][2] = {
+    {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}},
+    {{0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2}},
+    {{0, 0}, {0, 0}, {0, 0}, {0, 0}, {0, 0}},
+    {{0, 0}, {-1, 0}, {-1, -1}, {0, 2}, {-1, 2}},
+};
+constexpr int SRS_I_OFFSETS[4][5][2] = {
+    {{0, 0}, {-1, 0}, {2, 0}, {-1, 0}, {2, 0}},
+    {{-1, 0}, {0, 0}, {0, 0}, {0, 1}, {0, -2}},
+    {{-1, 1}, {1, 1}, {-2, 1}, {1, 0}, {-2, 0}},
+    {{0, 1}, {0, 1}, {0, 1}, {0, -1}, {0, 2}},
+};
+constexpr int SRS_O_OFFSETS[4][2] = {{0, 0}, {0, -1}, {-1, -1}, {-1, 0}};
+// tetr.io's srs+ kicks for I, per starting rotation and then clockwise or counterclockwise, tried after lining the piece up
+// like the first srs test does. unlike the guideline ones they don't come from offsets, the two directions out of 0 and 2
+// mirror each other and R and L kick the same whichever way they turn
+constexpr int SRS_PLUS_I_KICKS[4][2][5][2] = {
+    {{{0, 0}, {1, 0}, {-2, 0}, {-2, -1}, {1, 2}}, {{0, 0}, {-1, 0}, {2, 0}, {2, -1}, {-1, 2}}},
+    {{{0, 0}, {-1, 0}, {2, 0}, {-1, 2}, {2, -1}}, {{0, 0}, {-1, 0}, {2, 0}, {-1, 2}, {2, -1}}},
+    {{{0, 0}, {2, 0}, {-1, 0}, {2, 1}, {-1, -2}}, {{0, 0}, {-2, 0}, {1, 0}, {-2, 1}, {1, -2}}},
+    {{{0, 0}, {1, 0}, {-2, 0}, {1, -2}, {-2, 1}}, {{0, 0}, {1, 0}, {-2, 0}, {1, -2}, {-2, 1}}},
+};
+// tetr.io's 180 kicks, per starting rotation, tried after lining the piece up like the first srs test does
+constexpr int SPIN_180_KICKS[4][6][2] = {
+    {{0, 0}, {0, 1}, {1, 1}, {-1, 1}, {1, 0}, {-1, 0}},
+    {{0, 0}, {1, 0}, {1, 2}, {1, 1}, {0, 2}, {0, 1}},
+    {{0, 0}, {0, -1}, {-1, -1}, {1, -1}, {-1, 0}, {1, 0}},
+    {{0, 0}, {-1, 0}, {-1, 2}, {-1, 1}, {0, 2}, {0, 1}},
+};
+
+// the north layouts the srs offsets are written for
+inline std::array<std::array<int, 2>, 4> guideline_north(PieceType piece) {
+    switch (piece) {
+    case PieceType::I: return {{{-1, 0}, {0, 0}, {1, 0}, {2, 0}}};
+    case PieceType::O: return {{{0, 0}, {1, 0}, {0, 1}, {1, 1}}};
+    case PieceType::L: return {{{-1, 0}, {0, 0}, {1, 0}, {1, 1}}};
+    case PieceType::J: return {{{-1, 0}, {0, 0}, {1, 0}, {-1, 1}}};
+    case PieceType::S: return {{{-1, 0}, {0, 0}, {0, 1}, {1, 1}}};
+    case PieceType::Z: return {{{-1, 1}, {0, 1}, {0, 0}, {1, 0}}};
+    default: return {{{-1, 0}, {0, 0}, {1, 0}, {0, 1}}};
+    }
+}
+
+// every placement reachable from a spawn at (4, spawn_y) with tetr.io's srs+, which is srs with its own I kicks and 180 spins,
+// one board of piece positions per rotation
+// the library's bfs only knows srs, so this walks every position itself and is a good deal slower
+// kicks are defined for the guideline piece layout and translated onto the library's mino layout of every rotation
+inline std::array<Board, 4> srs180_movegen(const Board& board, PieceType piece, int spawn_y) {
+    // positions are kept with a margin so pieces whose minos all sit to one side of their center fit
+    constexpr int MARGIN = 3;
+    constexpr int WIDTH = Board::width + 2 * MARGIN;
+    constexpr int HEIGHT = Board::height + 2 * MARGIN;
+
+    const auto north = guideline_north(piece);
+
+    // the library's minos per rotation, and how far its position is from the guideline one
+    // a piece at (x, y) in the library's layout is at (x, y) + shift[r] in the guideline's
+    int cells[4][4][2];
+    int shift[4][2];
+    reachability::blocks::call_with_block<reachability::blocks::SRS>((char)piece, [&]<reachability::block B>(){
+        for (int r = 0; r < 4; ++r) {
+            std::array<std::pair<int, int>, 4> library{};
+            std::array<std::pair<int, int>, 4> guideline{};
+            for (int i = 0; i < 4; ++i) {
+                cells[r][i][0] = B.minos[B.mino_index[r]][i][0];
+                cells[r][i][1] = B.minos[B.mino_index[r]][i][1];
+                library[i] = {cells[r][i][0], cells[r][i][1]};
+
+                // rotating clockwise r times
+                int x = north[i][0], y = north[i][1];
+                for (int turn = 0; turn < r; ++turn)
+                    std::tie(x, y) = std::pair{y, -x};
+                guideline[i] = {x, y};
+            }
+            std::sort(library.begin(), library.end());
+            std::sort(guideline.begin(), guideline.end());
+            shift[r][0] = library[0].first - guideline[0].first;
+            shift[r][1] = library[0].second - guideline[0].second;
+        }
+    });
+
+    auto offset = [&](int r, int test) -> std::pair<int, int> {
+        if (piece == PieceType::I)
+            return {SRS_I_OFFSETS[r][test][0], SRS_I_OFFSETS[r][test][1]};
+        if (piece == PieceType::O)
+            return test == 0 ? std::pair{SRS_O_OFFSETS[r][0], SRS_O_OFFSETS[r][1]} : std::pair{0, 0};
+        return {SRS_OFFSETS[r][test][0], SRS_OFFSETS[r][test][1]};
+    };
+
+    const auto rows = board_rows(board);
+    auto fits = [&](int x, int y, int r) {
+        for (const auto& cell : cells[r]) {
+            const int cx = x + cell[0], cy = y + cell[1];
+            if (cx < 0 || cx >= (int)Board::width || cy < 0)
+                return false;
+            if (cy < (int)Board::height && (rows[cy] >> cx & 1))
+                return false;
+        }
+        return true;
+    };
+
+    std::array<Board, 4> result{};
+    if (!fits(4, spawn_y, 0))
+        return result;
+
+    std::vector<bool> seen(WIDTH * HEIGHT * 4);
+    std::vector<std::array<int, 3>> stack;
+    auto visit = [&](int x, int y, int r) {
+        if (x + MARGIN < 0 || x + MARGIN >= WIDTH || y + MARGIN < 0 || y + MARGIN >= HEIGHT)
+            return;
+        const size_t index = ((y + MARGIN) * WIDTH + x + MARGIN) * 4 + r;
+        if (seen[index] || !fits(x, y, r))
+            return;
+        seen[index] = true;
+        stack.push_back({x, y, r});
+    };
+    // tries the kicks from rotation r to to, in guideline coordinates, and moves to the first that fits
+    auto kick = [&](int x, int y, int r, int to, auto&& kicks, int tests) {
+        for (int test = 0; test < tests; ++test) {
+            const auto [kx, ky] = kicks(test);
+            const int nx = x + shift[r][0] + kx - shift[to][0];
+            const int ny = y + shift[r][1] + ky - shift[to][1];
+            if (fits(nx, ny, to)) {
+                visit(nx, ny, to);
+                return;
+            }
+        }
+    };
+
+    visit(4, spawn_y, 0);
+    while (!stack.empty()) {
+        const auto [x, y, r] = stack.back();
+        stack.pop_back();
+
+        if (!fits(x, y - 1, r) && x >= 0 && x < (int)Board::width && y >= 0 && y < (int)Board::height)
+            result[r].set(x, y);
+
+        visit(x - 1, y, r);
+        visit(x + 1, y, r);
+        visit(x, y - 1, r);
+        for (int to : {(r + 1) % 4, (r + 3) % 4}) {
+            kick(x, y, r, to, [&](int test) {
+                if (piece == PieceType::I) {
+                    const auto [fx, fy] = offset(r, 0);
+                    const auto [tx, ty] = offset(to, 0);
+                    const auto& kicks = SRS_PLUS_I_KICKS[r][to == (r + 1) % 4 ? 0 : 1];
+                    return std::pair{fx - tx + kicks[test][0], fy - ty + kicks[test][1]};
+                }
+                const auto [fx, fy] = offset(r, test);
+                const auto [tx, ty] = offset(to, test);
+                return std::pair{fx - tx, fy - ty};
+            }, 5);
+        }
+        const int flipped = (r + 2) % 4;
+        kick(x, y, r, flipped, [&](int test) {
+            const auto [fx, fy] = offset(r, 0);
+            const auto [tx, ty] = offset(flipped, 0);
+            return std::pair{fx - tx + SPIN_180_KICKS[r][test][0], fy - ty + SPIN_180_KICKS[r][test][1]};
+        }, 6);
+    }
+    return result;
+}
+
 struct Game {
     Board board;
     PieceType current_piece;
     std::optional<PieceType> hold;
     std::array<PieceType, QUEUE_SIZE> queue;
 
+    // movegen from a spawn at (4, spawn_y), under the rotation system of the rules
+    template <typename R, int spawn_y>
+    static auto spawn_movegen(const Board& board, PieceType piece) {
+        if constexpr (R::rotation == Rules::Rotation::SRS180) {
+            // the library's bfs would only be thrown away, srs180_movegen has a board for every rotation of the piece
+            auto spun = srs180_movegen(board, piece, spawn_y);
+            return reachability::static_vector<Board, 4UL>{std::span<Board, 4>(spun)};
+        } else {
+            return reachability::search::binary_bfs<reachability::blocks::SRS, reachability::coord{4, spawn_y}>(board, piece);
+        }
+    }
+
+    template <typename R = Rules::Srs>
+    static auto piece_movegen(const Board& board, PieceType piece) {
+        return spawn_movegen<R, 20>(board, piece);
+    }
+
+    // movegen for a piece that has to end up entirely below ceiling, only returns those placements
+    // when nothing is filled at or above the ceiling the rows between it and the normal spawn are empty and can't
+    // change what is reachable, so the piece spawns just above the ceiling and the bfs never floods the empty rows
+    template <typename R = Rules::Srs>
+    static auto piece_movegen(const Board& board, PieceType piece, int ceiling) {
+        auto moves = reachability::static_vector<Board, 4UL>{std::span<Board,0>()};
+
+        bool done = false;
+        if (!any_from_row(board, ceiling)) {
+            reachability::static_for<MAX_LOW_SPAWN_CEILING>([&](auto i) {
+                if (i + 1 == ceiling) {
+                    // room for the longest piece to rotate without touching the rows under the ceiling
+                    moves = spawn_movegen<R, int(i) + 1 + 2>(board, piece);
+                    done = true;
+                }
+            });
+        }
+        if (!done)
+            moves = piece_movegen<R>(board, piece);
+
+        // drop every placement that pokes out above the ceiling
+        reachability::blocks::call_with_block<reachability::blocks::SRS>(piece, [&]<reachability::block B>(){
+            for (std::size_t rot = 0; rot < moves.size(); ++rot) {
+                int top = B.minos[B.mino_index[rot]][0][1];
+                reachability::static_for<B.BLOCK_PER_MINO>([&](const std::size_t mino_i) {
+                    top = std::max(top, (int)B.minos[B.mino_index[rot]][mino_i][1]);
+                });
+                clear_rows_from(moves[rot], ceiling - top);
+            }
+        });
+        return moves;
+    }
+    template <typename R = Rules::Srs>
     auto current_piece_movegen() const {
         if (current_piece == PieceType::Empty) {
             // no moves possible, empty return
             auto ret = reachability::static_vector<Board, 4UL>{std::span<Board,0>()};
             return ret;
         }
-        return reachability::search::binary_bfs<reachability::blocks::SRS, reachability::coord{4,20}>(board, current_piece);
+        return piece_movegen<R>(board, current_piece);
     }
+    template <typename R = Rules::Srs>
     auto hold_piece_movegen() const {
         PieceType other = hold.value_or(queue.front());
-        if (other == current_piece || other == PieceType::Empty) {
+        if (!R::hold || other == current_piece || other == PieceType::Empty) {
             // no moves possible, empty return
             auto ret = reachability::static_vector<Board, 4UL>{std::span<Board,0>()};
             return ret;
         }
-        return reachability::search::binary_bfs<reachability::blocks::SRS, reachability::coord{4,20}>(board, other);
+        return piece_movegen<R>(board, other);
+    }
+    template <typename R = Rules::Srs>
+    auto current_piece_movegen(int ceiling) const {
+        if (current_piece == PieceType::Empty) {
+            // no moves possible, empty return
+            auto ret = reachability::static_vector<Board, 4UL>{std::span<Board,0>()};
+            return ret;
+        }
+        return piece_movegen<R>(board, current_piece, ceiling);
+    }
+    template <typename R = Rules::Srs>
+    auto hold_piece_movegen(int ceiling) const {
+        PieceType other = hold.value_or(queue.front());
+        if (!R::hold || other == current_piece || other == PieceType::Empty) {
+            // no moves possible, empty return
+            auto ret = reachability::static_vector<Board, 4UL>{std::span<Board,0>()};
+            return ret;
+        }
+        return piece_movegen<R>(board, other, ceiling);
     }
     auto empty_cells(int height) const {
         return height * 10 - board.popcount();
@@ -86,13 +513,8 @@ struct Game {
 
     private:
     void place_this_piece(FullPiece piece) {
-        reachability::blocks::call_with_block<reachability::blocks::SRS>(piece.type, [&]<reachability::block B>(){
-            reachability::static_for<B.BLOCK_PER_MINO>([&](const std::size_t mino_i) {
-                int px = piece.x + (B.minos[B.mino_index[piece.r]][mino_i][0]);
-                int py = piece.y + (B.minos[B.mino_index[piece.r]][mino_i][1]);
-                board.set(px, py);
-            });
-        });
+        for (const auto& [px, py] : piece_cells(piece))
+            board.set(px, py);
 
         current_piece = queue.front();
 